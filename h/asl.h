@@ -16,6 +16,7 @@ extern pcb_PTR removeBlocked(int *semAdd);
 extern pcb_PTR outBlocked(pcb_PTR p);
 extern pcb_PTR headBlocked(int *semAdd);
 extern void initASL();
+extern int semdHighWater();
 
 /***************************************************************/
 
@@ -123,8 +123,54 @@
 #define CPUTIMEGET 6
 #define CLOCKWAIT 7
 #define SUPPORTGET 8
+#define TODWAIT 25 /* numbered past the support level services, kernel mode SYS9 still passes up */
+#define CPUTIMESPLIT 26 /* kernel mode, fills the cpu_t array in a1 with the CPU time buckets */
+
+/* CPU time buckets, CPUTIMESPLIT fills a cpu_t array indexed by them */
+#define CPUTIME_USER 0      /* running the process, support level handlers included */
+#define CPUTIME_NUCLEUS 1   /* nucleus servicing the process's syscalls and exceptions */
+#define CPUTIME_INTERRUPT 2 /* interrupts taken while the process ran, not charged to it */
+#define CPUTIME_BUCKETS 3
 
 #define CLOCKINTERVAL 100000UL /* interval to V clock semaphore */
+
+/* timer wheel of the TODWAIT sleepers: level 0 holds the next WHEEL_SLOTS ticks one per slot,
+   each upper level WHEEL_SLOTS times coarser */
+#define WHEEL_TICK 1000  /* microseconds per level 0 slot */
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 3
+#define WHEEL_SPAN (1 << (WHEEL_BITS * WHEEL_LEVELS)) /* ticks covered by the wheel */
+#define INTERVALTMR_IDLE 0xFFFFFFFF /* interval timer value while neither a tick nor a deadline is due */
+
+/* Multi-level feedback queue scheduler */
+#define MLFQ_LEVELS 4          /* ready queue levels, level 0 has the highest priority */
+#define MLFQ_BASE_QUANTUM 5000 /* level 0 quantum in microseconds, doubled at each lower level */
+#define MLFQ_BOOST_TICKS 10    /* pseudo-clock ticks between two anti-starvation boosts */
+
+/* Multiprocessor nucleus: NCPU must match the processors of the machine config */
+#ifndef NCPU
+#define NCPU 1
+#endif
+#define NOCPU -1                /* pcb not yet bound to any processor */
+#define IRT_BASE 0x10000300     /* Interrupt Routing Table, one word per interrupt source */
+#define IRT_ENTRIES 48
+#define IRT_DYNAMIC 0x10000000  /* route to the lowest priority processor of the destination mask */
+#define IPI_INBOX 0x10000400    /* processor local inbox: last IPI received, written to acknowledge */
+#define IPI_OUTBOX 0x10000404   /* processor local outbox: written to send an IPI */
+#define IPI_RECIPIENT_SHIFT 16  /* recipient processors mask position in the outbox word */
+#define IPI_MSGMASK 0x000000FF
+#define IPI_WAKEUP 1            /* work was queued for an idle processor */
+#define IPI_TLBFLUSH 2          /* a page table entry was invalidated, clear the TLB */
+
+#if NCPU > 1
+#define CPUID() getPRID()
+#else
+#define CPUID() 0
+#endif
+
+/* The BIOS saves the exception state of processor i at the i-th state_t of the BIOS Data Page */
+#define CPU_EXCSTATE ((state_PTR)(BIOSDATAPAGE + (CPUID() * sizeof(state_t))))
 #define SYSCAUSE (0x8 << 2)
 
 /**********************************************************************************************
@@ -160,7 +206,7 @@
 #define VPN_SHIFT 12
 #define VPN_MASK 0x000FFFFF
 #define SWAP_POOL_SIZE 32
-#define SWAP_POOL_START 0x20020000 + BLOCKSIZE*16
+#define SWAP_POOL_START (0x20020000 + BLOCKSIZE*16)
 #define PAGE_TABLE_SIZE 32
 #define ASID_SHIFT 6
 #define UPROC_NUM 1
@@ -169,6 +215,18 @@
 #define TLB_STACK_AREA 499
 #define GEN_EXC_STACK_AREA 499
 
+/* Swap pool frame states */
+#define FRAME_FREE 0     /* holds no page */
+#define FRAME_INUSE 1    /* holds a valid page */
+#define FRAME_EVICTING 2 /* its dirty page is being written back to the swap disk */
+#define FRAME_FILLING 3  /* a page is being read into it */
+#define FRAME_CLEANING 4 /* its page stays mapped while the page cleaner writes it back */
+#define NOFRAME -1
+
+/* Page cleaner */
+#define CLEANER_LOW_FRAMES 4 /* the Pager wakes the cleaner when fewer frames are free */
+#define CLEANER_LOOKAHEAD 8  /* frames ahead of the clock hand the cleaner writes back */
+
 /* Constant bits for ENTRYHI and ENTRYLOW */
 #define DBITON 0x00000400
 #define VBITON 0x00000200
@@ -177,6 +235,8 @@
 #define GBITOFF 0xFFFFFEFF
 #define VBITOFF 0xFFFFFDFF
 #define PFN_MASK 0xFFFFF000
+#define TLBPROBEFAIL 0x80000000 /* Index.P: set by TLBP when no TLB entry matches EntryHi */
+#define TLBNOMATCHHI 0x00000000 /* EntryHi in kseg0, which is never translated: the slot matches nothing */
 
 /* U-PROC constants */
 #define UPROCSTARTADDR 0x800000B0
@@ -200,6 +260,11 @@
 #define TRANS_COMMAND_SHIFT 8
 #define RECEIVE_COMMAND_SHIFT 8
 #define COMMAND_SHIFT 8
+#define TERM_RING_SIZE 256 /* characters queued per terminal, two strings of STR_MAX */
+#define TERM_ERASE 8       /* BACKSPACE: erases the last character of the line being typed */
+#define TERM_DELETE 127    /* DEL: same as BACKSPACE */
+#define SPOOL_SIZE 1024    /* characters spooled per printer */
+#define SPOOL_JOBS 32      /* jobs spooled per printer */
 
 /**********************************************************************************************
  * Macros
@@ -230,13 +295,36 @@
 #define devSemIdx(intLineNo, devNo, termRead) (intLineNo - 3) * 8 + termRead * 8 + devNo;
 
 /* Maximum number of semaphore and pcb that can be allocated*/
+#ifndef MAXPROC
 #define MAXPROC 20
+#endif
 #define MAXSEM MAXPROC
 
+/* Swap pool page replacement policy, chosen at build time (make REPLACE=REPLACE_FIFO) */
+#define REPLACE_FIFO 0
+#define REPLACE_CLOCK 1 /* second chance, a page is referenced when the TLB is refilled with it */
+#ifndef PAGE_REPLACE_POLICY
+#define PAGE_REPLACE_POLICY REPLACE_CLOCK
+#endif
+/* 1: the instantiator checks at boot that page_replace never picks a pinned frame */
+#ifndef VM_SELFTEST
+#define VM_SELFTEST 0
+#endif
+
+/* Free RAM handed to the slab allocator: from the end of the swap pool up to
+   the frames kept at the top of RAM for the stacks of test, the daemons and p2test */
+#define SLAB_RAM_START (SWAP_POOL_START + (SWAP_POOL_SIZE * PAGESIZE))
+#define SLAB_STACK_RESERVE 48
+
+/* Number of buckets in the ASL hash table is (1 << ASLHASHBITS), kept above MAXSEM */
+#ifndef ASLHASHBITS
+#define ASLHASHBITS 5
+#endif
+
 #define BLOCKSIZE   PAGESIZE
 
 #define DISK_DMA_BUFFER_BASE_ADDR   0x20020000
-#define FLASK_DMA_BUFFER_BASE_ADDR  0x20020000 + BLOCKSIZE*8
+#define FLASK_DMA_BUFFER_BASE_ADDR  (0x20020000 + BLOCKSIZE*8)
 
 #define READBLK_DSK     3
 #define WRITEBLK_DSK    4
@@ -252,5 +340,29 @@
 #define BLOCKNUM_SHIFT  8
 
 #define RESERVED_DISK_NO 0
+#define NOCYL -1 /* arm position unknown: at boot, or after a failed seek */
+
+/* 1: copy every flash to the swap disk before the U-procs start, 0: page in from flash until written back */
+#ifndef EAGER_BACKING_STORE
+#define EAGER_BACKING_STORE 0
+#endif
+#define SETUP_RING (SWAP_POOL_SIZE / UPROC_NUM) /* bounce frames of each flash during the eager set up */
+#define SETUP_STACK_FRAME 3 /* frame below the top of RAM of the stack of the first set up reader */
+#define DISK_STACK_FRAME (SETUP_STACK_FRAME + DEVPERINT) /* stack of the dispatcher of disk 0, one frame per disk */
+#define PREFETCH_STACK_FRAME (DISK_STACK_FRAME + DEVPERINT) /* stack of the prefetch daemon */
+#define FLUSH_STACK_FRAME (PREFETCH_STACK_FRAME + 1) /* stack of the block cache flush daemon */
+#define TERMTX_STACK_FRAME (FLUSH_STACK_FRAME + 1) /* stack of the output daemon of terminal 0, one frame per terminal */
+#define TERMRX_STACK_FRAME (TERMTX_STACK_FRAME + DEVPERINT) /* stack of the input daemon of terminal 0, one frame per terminal */
+#define SPOOL_STACK_FRAME (TERMRX_STACK_FRAME + DEVPERINT) /* stack of the spooler of printer 0, one frame per printer */
+
+/* Write-back block cache */
+#define BLKCACHE_SIZE 16   /* blocks cached, each in a frame of kernel RAM */
+#define READAHEAD_BLOCKS 2 /* blocks prefetched after a sequential GET */
+#define FLUSH_DELAY 1000000 /* microseconds a dirty block may wait before the flush daemon writes it */
+#define BUF_EMPTY 0
+#define BUF_FILLING 1      /* the block is being read */
+#define BUF_VALID 2
+#define BUF_FLUSHING 3     /* the dirty block is being written back, still readable */
+#define NOBLOCK -2         /* no block read yet: never followed by a sequential one */
 
 #endif
@@ -14,6 +14,7 @@
 extern void freePcb(pcb_PTR p);
 extern pcb_PTR allocPcb();
 extern void initPcbs();
+extern int pcbHighWater();
 
 extern pcb_PTR mkEmptyProcQ();
 extern int emptyProcQ(pcb_PTR tp);
@@ -0,0 +1,23 @@
+#ifndef SLAB
+#define SLAB
+
+/************************** SLAB.H ******************************
+ *
+ *  The externals declaration file for the Slab Allocator
+ *    Module.
+ *
+ *  Written by Phuong and Oghap
+ */
+
+#include "../h/types.h"
+
+extern void initSlabPool(slabpool_t *pool, int objSize, void *bootTable, int bootCount);
+extern void *slabAlloc(slabpool_t *pool);
+extern void slabFree(slabpool_t *pool, void *obj);
+extern int slabHighWater(slabpool_t *pool);
+extern int slabFramesInUse();
+extern memaddr allocKernelFrame();
+
+/***************************************************************/
+
+#endif
@@ -81,8 +81,60 @@ typedef struct swapPoolFrame_t {
 	int ASID;                    /* The ASID of the U-proc whose page is occupying the frame*/
 	int VPN;                    /* The logical page number (VPN) of the occupying page.*/
 	pte_t *matchingPgTableEntry; /* A pointer to the matching Page Table entry in the Page Table belonging to the owner process. (i.e. ASID)*/
+	int referenced;              /* set by a TLB refill of the page, cleared by the clock hand*/
+	int state;                   /* FRAME_FREE, FRAME_INUSE, FRAME_EVICTING, FRAME_FILLING or FRAME_CLEANING*/
+	int waitSem;                 /* wait queue of the U-procs waiting for the frame transfer to end*/
+	int waiters;                 /* U-procs blocked on waitSem*/
+	int pinned;                  /* device transfers in flight on the frame, never replaced while > 0*/
 } swapPoolFrame_t;
 
+/* spool of a printer, jobs appended by SYS11 and printed in FIFO order by the spooler of the printer */
+typedef struct spool_t {
+	char sp_ring[SPOOL_SIZE];  /* characters of the spooled jobs */
+	int sp_head;               /* next character to print */
+	int sp_count;              /* characters spooled, the one being printed included */
+	int sp_jobLen[SPOOL_JOBS]; /* characters left of each spooled job */
+	int sp_jobHead;            /* job being printed */
+	int sp_jobs;               /* jobs not fully printed */
+	int sp_error;              /* status of the first failed PRINTCHR not reported yet, 0 if none */
+	int sp_lock;               /* mutex of the spool */
+	int sp_writer;             /* mutex of the SYS11 callers */
+	int sp_asleep;             /* TRUE while the spooler waits on sp_work */
+	int sp_work;               /* the spooler waits here for jobs */
+	int sp_spaceWanted;        /* TRUE while a SYS11 waits on sp_space */
+	int sp_space;              /* a SYS11 waits here for the spool to have room */
+	int sp_flushWaiters;       /* callers blocked on sp_drained */
+	int sp_drained;            /* flush callers wait here for the spool to empty */
+} spool_t;
+
+/* transmit ring of a terminal, filled by SYS12 and drained by the output daemon of the terminal */
+typedef struct termtx_t {
+	char tx_ring[TERM_RING_SIZE]; /* characters waiting to be transmitted */
+	int tx_head;                  /* next character to transmit */
+	int tx_count;                 /* characters in the ring, the one being transmitted included */
+	int tx_error;                 /* status of the first failed transmission not reported yet, 0 if none */
+	int tx_lock;                  /* mutex of the ring */
+	int tx_writer;                /* mutex of the SYS12 callers, so strings are not interleaved */
+	int tx_asleep;                /* TRUE while the daemon waits on tx_work */
+	int tx_work;                  /* the daemon waits here for characters */
+	int tx_spaceWanted;           /* TRUE while a SYS12 waits on tx_space */
+	int tx_space;                 /* a SYS12 waits here for the ring to have room */
+	int tx_flushWaiters;          /* callers blocked on tx_drained */
+	int tx_drained;               /* flush callers wait here for the ring to empty */
+} termtx_t;
+
+/* input ring of a terminal, filled by its input daemon and read a line at a time by SYS13 */
+typedef struct termrx_t {
+	char rx_ring[TERM_RING_SIZE]; /* completed lines, then the line being typed */
+	int rx_head;                  /* first character of the oldest line */
+	int rx_count;                 /* characters in the ring */
+	int rx_partial;               /* characters of the line being typed, at the end of the ring */
+	int rx_lines;                 /* completed lines not read yet */
+	int rx_error;                 /* status of a failed receive not reported yet, 0 if none */
+	int rx_lock;                  /* mutex of the ring */
+	int rx_lineReady;             /* SYS13 waits here, one V per completed line or failed receive */
+} termrx_t;
+
 /**********************************************************************************************
  * pcb related structs
  */
@@ -112,24 +164,57 @@ typedef struct support_t {
 	pte_t sup_privatePgTbl[32];     /* A Pandos Page Table will be an array of 32 Page Table entries _ pg 43 pandos */
 	int sup_stackTlb[500];          /* 2Kb area for the stack area for the process TLB exception handler*/
 	int sup_stackGen[500];          /* 2Kb area for the stack area for the process's Support Level general exception handler*/
-
-	int delaySem; /* delay facility for phase 5*/
 } support_t;
 
 /********************************************************************************************
- * phase 5 structs
+ * phase 4 structs
  */
 
-typedef struct delayd_t {
-	struct delayd_t *d_next;
-	int d_wakeTime;	/* the time of day when the U-proc should be woken */
-	support_t *d_supStruct;
-} delayd_t;
+/* one block transfer queued on a disk, on the stack of the requester */
+typedef struct diskreq_t {
+	struct diskreq_t *dr_next; /* next request of the disk queue */
+	int dr_cyl;                /* cylinder of the block */
+	int dr_head;               /* head of the block */
+	int dr_sect;               /* sector of the block */
+	memaddr dr_buf;            /* RAM address transferred */
+	int dr_write;              /* TRUE to write the block, FALSE to read it */
+	int dr_status;             /* READY or negated device status, set by the dispatcher */
+	int dr_done;               /* the requester waits here until served */
+} diskreq_t;
+
+/* disk state kept by the support level: geometry read once at boot, arm position and request queue */
+typedef struct disk_t {
+	int dk_maxcyl;       /* cylinders, from DATA1 */
+	int dk_maxhead;      /* heads, from DATA1 */
+	int dk_maxsect;      /* sectors per track, from DATA1 */
+	int dk_cyl;          /* cylinder the arm sits on, NOCYL when unknown */
+	int dk_seeks;        /* SEEKCYL commands issued */
+	int dk_seeksSkipped; /* seeks not issued, the arm already sat on the cylinder */
+	diskreq_t *dk_queue; /* requests waiting for the dispatcher, in arrival order */
+	int dk_queueLock;    /* mutex of dk_queue */
+	int dk_pending;      /* requests queued, the dispatcher waits here */
+	int dk_bounceSem;    /* mutex of the DMA bounce buffer of the disk */
+} disk_t;
+
+/* block cache entry, holding one disk or flash block in a frame of kernel RAM */
+typedef struct blkbuf_t {
+	int bb_class;    /* DISKINT or FLASHINT */
+	int bb_devNo;    /* device number */
+	int bb_block;    /* block number on the device */
+	int bb_state;    /* BUF_EMPTY, BUF_FILLING, BUF_VALID or BUF_FLUSHING */
+	int bb_dirty;    /* PUT since the block was last written to the device */
+	int bb_lastUse;  /* LRU stamp */
+	int bb_waiters;  /* GETs and PUTs blocked on bb_waitSem */
+	int bb_waitSem;  /* wait here for the transfer on the entry to end */
+	memaddr bb_data; /* the block */
+} blkbuf_t;
 
 typedef struct pcb_t {
 	/* process queue fields */
 	struct pcb_t *p_next; /* ptr to next entry */
 	struct pcb_t *p_prev; /* ptr to previous entry */
+	struct pcb_t **p_queue; /* ptr to the tail ptr of */
+	                        /* the queue proc is on */
 	                      /* process tree fields */
 	struct pcb_t *p_prnt, /* ptr to parent */
 	  *p_child,           /* ptr to 1st child */
@@ -137,17 +222,55 @@ typedef struct pcb_t {
 	  *p_prev_sib;        /* ptr to prev. sibling */
 	                      /* process status information */
 	state_t p_s;          /* processor state */
-	cpu_t p_time;         /* cpu time used by proc */
+	cpu_t p_time[CPUTIME_BUCKETS]; /* cpu time used by proc, per bucket */
+	int p_prio;           /* ready queue level, 0 highest */
+	int p_cpu;            /* processor whose ready queue */
+	                      /* proc was last put on */
 	int *p_semAdd;        /* ptr to semaphore on */
 	                      /* which proc is blocked */
+	cpu_t p_wakeTime;     /* TOD a TODWAIT (SYS25) sleeps until */
+	struct pcb_t *p_timerNext; /* next sleeper on the same timer list */
 	                      /* support layer information */
 	support_t *p_supportStruct;
 } pcb_t, *pcb_PTR;
 
+/* nucleus state private to one processor */
+typedef struct percpu_t {
+	pcb_PTR pc_currentP;             /* process running on this processor */
+	int pc_quantum;                  /* PLT quantum pc_currentP was dispatched with */
+	cpu_t pc_mark;                   /* TOD up to which pc_currentP has been charged */
+	pcb_PTR pc_readyQ[MLFQ_LEVELS];  /* tail ptrs of the ready queues, one per level */
+	int pc_readyBitmap;              /* bit i set when pc_readyQ[i] is not empty */
+	int pc_idle;                     /* TRUE while the processor sits in WAIT() */
+	memaddr pc_stackTop;             /* top of the nucleus stack of this processor */
+} percpu_t;
+
 /********************************************************************************************
  * phase 1 structs
  */
 
+/* slab: one RAM frame carved into objects of a single pool, header at the start of the frame */
+typedef struct slab_t {
+	struct slab_t *sl_next; /* next slab on the same pool list */
+	struct slab_t *sl_prev; /* previous slab on the same pool list */
+	void *sl_free;          /* first free object in this slab */
+	int sl_inUse;           /* objects of this slab handed out */
+} slab_t;
+
+/* pool of same sized objects: a static boot table first, then slabs taken from free RAM */
+typedef struct slabpool_t {
+	int sp_objSize;      /* object size rounded up to a word */
+	int sp_perSlab;      /* objects fitting in one slab */
+	memaddr sp_bootBase; /* static table handed out before any slab */
+	memaddr sp_bootEnd;  /* first address after the static table */
+	void *sp_bootFree;   /* free objects of the static table */
+	slab_t *sp_partial;  /* slabs with at least one free object */
+	slab_t *sp_full;     /* slabs with every object handed out */
+	int sp_slabs;        /* slabs currently owned by the pool */
+	int sp_inUse;        /* objects currently handed out */
+	int sp_highWater;    /* most objects ever handed out at once */
+} slabpool_t;
+
 /* semaphore descriptor type */
 typedef struct semd_t {
 	struct semd_t *s_next; /* next element on the ASL */
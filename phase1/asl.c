@@ -1,11 +1,13 @@
 /*********************************ASL.C*******************************
  *  Implementation of the Active Semaphore List
- *      Maintains a sorted NULL-terminated single, linked
- *      lists of semaphore descriptors pointed to by pointer semd_h
- *      Also maintains the semdFree list, to hold the unused semaphore descriptors.
- *      For greater ASL traversal efficiency, we place
- *      a dummy node at both the head (s semAdd ← 0) and
- *      tail (s semAdd ← MAXINT) of the ASL
+ *      Maintains the active semaphore descriptors in a hash table
+ *      indexed by the semaphore address (s_semAdd). Each bucket of
+ *      semdHash is a NULL-terminated single, linked list of semaphore
+ *      descriptors, so finding the descriptor of a semaphore only walks
+ *      the few descriptors that hash to the same bucket instead of the
+ *      whole ASL.
+ *      The unused semaphore descriptors are kept by the slab allocator, which
+ *      hands out the static semdTable first and then grows by slabs of free RAM.
  *      This module includes public functions to support initializing ASL,
  *      insert into queue of a sema4 in ASL using insertBlockec(),
  *      removing from head queue of a sema4 in ASL using removeBlocked(),
@@ -16,14 +18,18 @@
  */
 
 #include "../h/pcb.h"
-#define MAXPROC 20
+#include "../h/slab.h"
 
-HIDDEN semd_t *semdFree_h;
-static semd_t semdTable[MAXPROC + 2];
-static semd_t *semd_h = NULL;
+#define ASLHASHSIZE (1 << ASLHASHBITS) /* number of buckets in the ASL hash table */
+#define ASLHASHMASK (ASLHASHSIZE - 1)
+#define SEMADD_SHIFT 2                 /* semaphores are word aligned, low 2 bits are always 0 */
+
+HIDDEN slabpool_t semdPool;
+static semd_t semdTable[MAXSEM];
+static semd_t *semdHash[ASLHASHSIZE];
 
 /**********************************************************
- *  Cleaning the sema4 before adding to the semdFree_h
+ *  Cleaning the sema4 before giving it back to the semd pool
  *
  *  Parameters:
  *         semd_t *p : pointer to the sema4 to be free
@@ -35,13 +41,12 @@ static semd_t *semd_h = NULL;
 void freeSemd(semd_t *p) {
 	/*set sema4 queue pointer to NULL, assuming there is no pcb inside it*/
 	p->s_procQ = NULL;
-	/*adding sema4 to the free sema4 list*/
-	p->s_next = semdFree_h;
-	semdFree_h = p;
+	/*adding sema4 back to the semd pool*/
+	slabFree(&semdPool, p);
 }
 
 /**********************************************************
- *  Initializing the sema4 before after removing from the semdFree_h list
+ *  Initializing the sema4 after taking it from the semd pool
  *
  *  Parameters:
  *         int* semAdd :  the address to initialize for the new sema4
@@ -51,14 +56,13 @@ void freeSemd(semd_t *p) {
  *
  */
 semd_t *allocSemd(int *semAdd) {
+	/*taking a sema4 from the pool, which grows by a slab if needed*/
+	semd_t *allocatedSemd = slabAlloc(&semdPool);
+
 	/*special case no free sema4 to allocate*/
-	if(semdFree_h == NULL) {
+	if(allocatedSemd == NULL) {
 		return NULL;
 	}
-	/*removing the first sema4 in semdFree_h*/
-	semd_t *allocatedSemd = semdFree_h;
-
-	semdFree_h = semdFree_h->s_next;
 
 	/*initialize its attributes*/
 	allocatedSemd->s_next = NULL;
@@ -69,8 +73,8 @@ semd_t *allocSemd(int *semAdd) {
 }
 
 /**********************************************************
- *  Filling the semaFree_h list with sema4 from semdTable
- *  Adding 2 dummy nodes into the semd_h list using allocSemd()
+ *  Making semdTable the boot table of the semd pool
+ *  Emptying every bucket of the semdHash table
  *
  *  Parameters:
  *
@@ -80,43 +84,54 @@ semd_t *allocSemd(int *semAdd) {
  *
  */
 void initASL() {
-	/*adding the first sema4 from semdTable to the semdFree_h list*/
-	semdFree_h = &(semdTable[0]);
+	/*the sema4 of semdTable are handed out before the pool grows*/
+	initSlabPool(&semdPool, sizeof(semd_t), semdTable, MAXSEM);
+
+	/*every bucket starts as an empty list*/
 	int i;
-	/*adding and connecting the rest sema4 from semdTable to the semdFree_h list*/
-	for(i = 0; i < MAXPROC + 1; i = i + 1) {
-		(semdTable[i]).s_next = &(semdTable[i + 1]);
+	for(i = 0; i < ASLHASHSIZE; i = i + 1) {
+		semdHash[i] = NULL;
 	}
-	/*making the s_next pointer of the tail node NULL*/
-	(semdTable[i]).s_next = NULL;
+}
 
-	/*allocating and adding the two dummy node into the ASL*/
-	semd_t *headDummy = allocSemd(0);
-	semd_t *tailDummy = allocSemd(&(semdTable[MAXPROC + 1]));
-	semd_h = tailDummy;
-	headDummy->s_next = semd_h;
-	semd_h = headDummy;
+/**********************************************************
+ *  A Helper Function: Compute the bucket of the semdHash table
+ *  that a sema4 address belongs to
+ *
+ *  Parameters:
+ *         int* semAdd : the sema4 descriptor to hash
+ *
+ *
+ *  Returns:
+ *         int : index of the bucket in semdHash
+ *
+ */
+HIDDEN int hashSemAdd(int *semAdd) {
+	memaddr key = ((memaddr)semAdd) >> SEMADD_SHIFT;
+	/*fold the higher bits in so semaphores in different pages do not pile up in one bucket*/
+	return (key ^ (key >> ASLHASHBITS)) & ASLHASHMASK;
 }
 
 /**********************************************************
- *  A Helper Function: Traverse the ASL to look for the sema4 with largest address
- *  that is smaller than the provided address of a sema4 (possible pointer)
+ *  A Helper Function: Look in the bucket of the provided sema4 address
+ *  for the link (bucket head or s_next field) that points to its sema4
  *
  *  Parameters:
  *         int* semAdd : the sema4 descriptor to look for
  *
  *
  *  Returns:
- *         semd_t *traverse : pointer to the possible predecessor sema4
+ *         semd_t **link : address of the link pointing to the sema4,
+ *                         or of the NULL link ending the bucket if not found
  *
  */
-semd_t *traverseASL(int *semAdd) {
-	semd_t *traverse = semd_h;
-	/*the loop that move traverse pointer until the the next sema4 no longer has the descriptor smaller than the given sema4 descriptor*/
-	while(traverse->s_next->s_semAdd != &(semdTable[MAXPROC + 1]) && traverse->s_next->s_semAdd < semAdd) {
-		traverse = traverse->s_next;
+semd_t **traverseASL(int *semAdd) {
+	semd_t **link = &(semdHash[hashSemAdd(semAdd)]);
+	/*the loop that move link pointer until it points to the sema4 or to the end of the bucket*/
+	while((*link) != NULL && (*link)->s_semAdd != semAdd) {
+		link = &((*link)->s_next);
 	}
-	return traverse;
+	return link;
 }
 
 /**********************************************************
@@ -133,19 +148,19 @@ semd_t *traverseASL(int *semAdd) {
  *
  */
 int insertBlocked(int *semAdd, pcb_PTR p) {
-	/*look for the predecessor*/
-	semd_t *predecessor = traverseASL(semAdd);
+	/*look for the link to the sema4*/
+	semd_t **link = traverseASL(semAdd);
 	/*special case where the given sema4 descriptor does not exist in ASL*/
-	if(predecessor->s_next->s_semAdd != semAdd) {
+	if((*link) == NULL) {
 		semd_t *newSem = allocSemd(semAdd);
 		if(newSem == NULL) {
 			return TRUE;
 		}
-		newSem->s_next = predecessor->s_next;
-		predecessor->s_next = newSem;
+		/*order inside a bucket does not matter, so new sema4 goes at the end where link already points*/
+		*link = newSem;
 	}
 	/*insert into the queue of the found sema4 using insertProcQ from pcb module*/
-	insertProcQ(&(predecessor->s_next->s_procQ), p);
+	insertProcQ(&((*link)->s_procQ), p);
 	p->p_semAdd = semAdd;
 	return FALSE;
 }
@@ -163,14 +178,14 @@ int insertBlocked(int *semAdd, pcb_PTR p) {
  *
  */
 pcb_PTR removeBlocked(int *semAdd) {
-	/*look for the predecessor*/
-	semd_t *predecessor = traverseASL(semAdd);
+	/*look for the link to the sema4*/
+	semd_t **link = traverseASL(semAdd);
 	/*special case where the given sema4 descriptor does not exist in ASL*/
-	if(predecessor->s_next->s_semAdd != semAdd) {
+	if((*link) == NULL) {
 		return NULL;
 	}
 	/*remove the queue of the found sema4 using removeProcQ from pcb module*/
-	pcb_PTR resultPcb = removeProcQ(&(predecessor->s_next->s_procQ));
+	pcb_PTR resultPcb = removeProcQ(&((*link)->s_procQ));
 	/*special case where the sema4 found but empty*/
 	if(resultPcb == NULL) {
 		return NULL;
@@ -178,9 +193,9 @@ pcb_PTR removeBlocked(int *semAdd) {
 	/*fixing the pointer to the sema4 of pcb to NULL*/
 	resultPcb->p_semAdd = NULL;
 	/*removing sema4 from ASL if no longer active*/
-	if(emptyProcQ(predecessor->s_next->s_procQ)) {
-		semd_t *toBeFreeSem = predecessor->s_next;
-		predecessor->s_next = predecessor->s_next->s_next;
+	if(emptyProcQ((*link)->s_procQ)) {
+		semd_t *toBeFreeSem = *link;
+		*link = toBeFreeSem->s_next;
 		freeSemd(toBeFreeSem);
 	}
 	return resultPcb;
@@ -199,14 +214,21 @@ pcb_PTR removeBlocked(int *semAdd) {
  */
 pcb_PTR outBlocked(pcb_PTR p) {
 	int *semAdd = p->p_semAdd;
-	/*look for the predecessor*/
-	semd_t *predecessor = traverseASL(semAdd);
+	/*look for the link to the sema4*/
+	semd_t **link = traverseASL(semAdd);
 	/*special case where the given sema4 descriptor does not exist in ASL or its queue is empty*/
-	if(predecessor->s_next->s_semAdd != semAdd || emptyProcQ(predecessor->s_next->s_procQ)) {
+	if((*link) == NULL || emptyProcQ((*link)->s_procQ)) {
 		return NULL;
 	}
 	/*remove pcb from the queue of the found sema4 using outProcQ() from pcb module*/
-	return outProcQ(&(predecessor->s_next->s_procQ), p);
+	pcb_PTR resultPcb = outProcQ(&((*link)->s_procQ), p);
+	/*removing sema4 from ASL if no longer active*/
+	if(emptyProcQ((*link)->s_procQ)) {
+		semd_t *toBeFreeSem = *link;
+		*link = toBeFreeSem->s_next;
+		freeSemd(toBeFreeSem);
+	}
+	return resultPcb;
 }
 /**********************************************************
  *  Accessing head of a queue of a sema4 in ASL
@@ -220,12 +242,26 @@ pcb_PTR outBlocked(pcb_PTR p) {
  *
  */
 pcb_PTR headBlocked(int *semAdd) {
-	/*look for the predecessor*/
-	semd_t *predecessor = traverseASL(semAdd);
+	/*look for the link to the sema4*/
+	semd_t **link = traverseASL(semAdd);
 	/*special case where the given sema4 descriptor does not exist in ASL or its queue is empty*/
-	if(predecessor->s_next->s_semAdd != semAdd || emptyProcQ(predecessor->s_next->s_procQ)) {
+	if((*link) == NULL || emptyProcQ((*link)->s_procQ)) {
 		return NULL;
 	}
 	/*return the head pcb of the queue of the specified*/
-	return predecessor->s_next->s_procQ->p_next;
+	return (*link)->s_procQ->p_next;
+}
+
+/**********************************************************
+ *  Reporting the most sema4 that were ever active at the same time
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *         int : high-water mark of the semd pool
+ *
+ */
+int semdHighWater() {
+	return slabHighWater(&semdPool);
 }
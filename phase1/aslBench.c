@@ -0,0 +1,185 @@
+/*********************************ASLBENCH.C*******************************
+ *
+ *  Host side microbenchmark for the Active Semaphore List.
+ *
+ *  Compares the hash-indexed ASL in asl.c against the previous layout
+ *  (one sorted, singly linked list with a dummy node at each end)
+ *  which is kept below as old_*. Both are driven with the same random
+ *  P/V mix over 20, 200 and 2000 active semaphores, and the average
+ *  time per operation is printed.
+ *
+ *  This is not part of the kernel: it is built with the host compiler
+ *  by "make bench" with MAXPROC raised so the pools can hold 2000
+ *  blocked pcbs.
+ *
+ *      Written by Phuong and Oghap
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* const.h brings its own NULL for the kernel, use that one */
+#undef NULL
+
+#include "../h/pcb.h"
+#include "../h/asl.h"
+
+#define BENCH_OPS 2000000 /* P/V operations timed for each size */
+
+HIDDEN int benchSizes[] = {20, 200, 2000};
+HIDDEN int sem[MAXSEM];
+HIDDEN pcb_PTR procp[MAXPROC];
+
+/* The previous ASL: sorted list from old_semd_h with dummy head (s_semAdd 0) and tail */
+
+HIDDEN semd_t *old_semdFree_h;
+HIDDEN semd_t old_semdTable[MAXSEM + 2];
+HIDDEN semd_t *old_semd_h;
+
+HIDDEN void old_freeSemd(semd_t *p) {
+	p->s_procQ = NULL;
+	p->s_next = old_semdFree_h;
+	old_semdFree_h = p;
+}
+
+HIDDEN semd_t *old_allocSemd(int *semAdd) {
+	if(old_semdFree_h == NULL) {
+		return NULL;
+	}
+	semd_t *allocatedSemd = old_semdFree_h;
+	old_semdFree_h = old_semdFree_h->s_next;
+	allocatedSemd->s_next = NULL;
+	allocatedSemd->s_semAdd = semAdd;
+	allocatedSemd->s_procQ = mkEmptyProcQ();
+	return allocatedSemd;
+}
+
+HIDDEN void old_initASL() {
+	int i;
+	old_semdFree_h = &(old_semdTable[0]);
+	for(i = 0; i < MAXSEM + 1; i = i + 1) {
+		(old_semdTable[i]).s_next = &(old_semdTable[i + 1]);
+	}
+	(old_semdTable[i]).s_next = NULL;
+
+	semd_t *headDummy = old_allocSemd(0);
+	semd_t *tailDummy = old_allocSemd((int *)&(old_semdTable[MAXSEM + 1]));
+	headDummy->s_next = tailDummy;
+	old_semd_h = headDummy;
+}
+
+HIDDEN semd_t *old_traverseASL(int *semAdd) {
+	semd_t *traverse = old_semd_h;
+	while(traverse->s_next->s_semAdd != (int *)&(old_semdTable[MAXSEM + 1]) && traverse->s_next->s_semAdd < semAdd) {
+		traverse = traverse->s_next;
+	}
+	return traverse;
+}
+
+HIDDEN int old_insertBlocked(int *semAdd, pcb_PTR p) {
+	semd_t *predecessor = old_traverseASL(semAdd);
+	if(predecessor->s_next->s_semAdd != semAdd) {
+		semd_t *newSem = old_allocSemd(semAdd);
+		if(newSem == NULL) {
+			return TRUE;
+		}
+		newSem->s_next = predecessor->s_next;
+		predecessor->s_next = newSem;
+	}
+	insertProcQ(&(predecessor->s_next->s_procQ), p);
+	p->p_semAdd = semAdd;
+	return FALSE;
+}
+
+HIDDEN pcb_PTR old_removeBlocked(int *semAdd) {
+	semd_t *predecessor = old_traverseASL(semAdd);
+	if(predecessor->s_next->s_semAdd != semAdd) {
+		return NULL;
+	}
+	pcb_PTR resultPcb = removeProcQ(&(predecessor->s_next->s_procQ));
+	if(resultPcb == NULL) {
+		return NULL;
+	}
+	resultPcb->p_semAdd = NULL;
+	if(emptyProcQ(predecessor->s_next->s_procQ)) {
+		semd_t *toBeFreeSem = predecessor->s_next;
+		predecessor->s_next = predecessor->s_next->s_next;
+		old_freeSemd(toBeFreeSem);
+	}
+	return resultPcb;
+}
+
+/**********************************************************
+ *  Time BENCH_OPS operations on a set of n active semaphores.
+ *  Every semaphore starts with one blocked pcb, then each step
+ *  unblocks the pcb of a random semaphore (V) and blocks it
+ *  again on another random semaphore (P), so the number of
+ *  active semaphores stays close to n.
+ *
+ *  Parameters:
+ *         int n : number of active semaphores
+ *         int useOld : TRUE to drive the old sorted list
+ *
+ *  Returns:
+ *         double : nanoseconds per operation
+ */
+HIDDEN double run_bench(int n, int useOld) {
+	struct timespec start, end;
+	int i;
+	int from, to;
+	pcb_PTR p;
+
+	initPcbs();
+	if(useOld) {
+		old_initASL();
+	} else {
+		initASL();
+	}
+	for(i = 0; i < n; i++) {
+		procp[i] = allocPcb();
+		if(useOld) {
+			old_insertBlocked(&sem[i], procp[i]);
+		} else {
+			insertBlocked(&sem[i], procp[i]);
+		}
+	}
+
+	srand(n);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(i = 0; i < BENCH_OPS; i++) {
+		from = rand() % n;
+		to = rand() % n;
+		if(useOld) {
+			p = old_removeBlocked(&sem[from]);
+			if(p != NULL) {
+				old_insertBlocked(&sem[to], p);
+			}
+		} else {
+			p = removeBlocked(&sem[from]);
+			if(p != NULL) {
+				insertBlocked(&sem[to], p);
+			}
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / (2.0 * BENCH_OPS);
+}
+
+int main() {
+	int i;
+	double oldNs, newNs;
+
+	printf("%-12s %14s %14s %10s\n", "semaphores", "sorted ns/op", "hash ns/op", "speedup");
+	for(i = 0; i < (int)(sizeof(benchSizes) / sizeof(benchSizes[0])); i++) {
+		if(benchSizes[i] > MAXSEM) {
+			printf("%-12d skipped: MAXPROC is %d\n", benchSizes[i], MAXPROC);
+			continue;
+		}
+		oldNs = run_bench(benchSizes[i], TRUE);
+		newNs = run_bench(benchSizes[i], FALSE);
+		printf("%-12d %14.1f %14.1f %9.2fx\n", benchSizes[i], oldNs, newNs, oldNs / newNs);
+	}
+	return 0;
+}
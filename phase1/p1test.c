@@ -30,6 +30,15 @@ int onesem;
 pcb_t *procp[MAXPROC], *p, *qa, *q, *firstproc, *lastproc, *midproc;
 char *mp = okbuf;
 
+#define STRESSOPS 5000 /* random operations in each stress test */
+#define STRESSQS 3     /* process queues (or parents) used by the stress tests */
+#define NOQUEUE -1
+
+pcb_t *stressQ[STRESSQS];  /* tail pointers of the stress test queues */
+int stressOn[MAXPROC];     /* which stress queue (or parent) procp[i] is on */
+int stressLen[STRESSQS];   /* expected length of each stress queue */
+unsigned int stressSeed = 372;
+
 #define TRANSMITTED 5
 #define ACK 1
 #define PRINTCHR 2
@@ -91,6 +100,36 @@ unsigned int termprint(char *str, unsigned int term) {
 	return (!error);
 }
 
+/* Simple linear congruential generator, returns a value in [0, bound) */
+int stressRand(int bound) {
+	stressSeed = stressSeed * 1103515245 + 12345;
+	return ((stressSeed >> 16) & 0x7FFF) % bound;
+}
+
+/* Returns the index of p in procp[] */
+int stressIdx(pcb_t *p) {
+	int i;
+	for(i = 0; i < MAXPROC; i++)
+		if(procp[i] == p)
+			return i;
+	return NOQUEUE;
+}
+
+/* Walks the stress queue k and returns the number of pcbs on it */
+int stressCount(int k) {
+	int n = 0;
+	pcb_t *walk;
+
+	if(emptyProcQ(stressQ[k]))
+		return 0;
+	walk = headProcQ(stressQ[k]);
+	do {
+		n++;
+		walk = walk->p_next;
+	} while(walk != headProcQ(stressQ[k]) && n <= MAXPROC);
+	return n;
+}
+
 /* This function placess the specified character string in okbuf and
  *	causes the string to be written out to terminal0 */
 void addokbuf(char *strp) {
@@ -127,9 +166,13 @@ void main() {
 		if((procp[i] = allocPcb()) == NULL)
 			adderrbuf("allocPcb: unexpected NULL   ");
 	}
-	if(allocPcb() != NULL) {
-		adderrbuf("allocPcb: allocated more than MAXPROC entries   ");
+	/* the pool grows by a slab past the static MAXPROC entries */
+	if((q = allocPcb()) == NULL) {
+		adderrbuf("allocPcb: pool did not grow past MAXPROC entries   ");
 	}
+	freePcb(q);
+	if(pcbHighWater() != MAXPROC + 1)
+		adderrbuf("pcbHighWater: wrong high-water mark   ");
 	addokbuf("allocPcb ok   \n");
 
 	/* return the last 10 entries back to free list */
@@ -242,6 +285,106 @@ void main() {
 	for(i = 0; i < 10; i++)
 		freePcb(procp[i]);
 
+	/* stress outProcQ: random inserts, removes and outs across several queues */
+	addokbuf("process queue stress test started   \n");
+	for(i = 0; i < MAXPROC; i++) {
+		if((procp[i] = allocPcb()) == NULL)
+			adderrbuf("allocPcb: unexpected NULL in stress test   ");
+		stressOn[i] = NOQUEUE;
+	}
+	for(i = 0; i < STRESSQS; i++) {
+		stressQ[i] = mkEmptyProcQ();
+		stressLen[i] = 0;
+	}
+	for(i = 0; i < STRESSOPS; i++) {
+		int k = stressRand(STRESSQS);
+		int j = stressRand(MAXPROC);
+		switch(stressRand(3)) {
+			case 0:
+				if(stressOn[j] == NOQUEUE) {
+					insertProcQ(&stressQ[k], procp[j]);
+					stressOn[j] = k;
+					stressLen[k]++;
+				}
+				break;
+			case 1:
+				q = outProcQ(&stressQ[k], procp[j]);
+				if(stressOn[j] == k) {
+					if(q != procp[j])
+						adderrbuf("outProcQ stress: failed to out a member   ");
+					stressOn[j] = NOQUEUE;
+					stressLen[k]--;
+				} else if(q != NULL)
+					adderrbuf("outProcQ stress: removed a nonmember   ");
+				break;
+			default:
+				q = removeProcQ(&stressQ[k]);
+				if(stressLen[k] == 0) {
+					if(q != NULL)
+						adderrbuf("removeProcQ stress: removed from empty queue   ");
+				} else {
+					if(q == NULL || stressOn[stressIdx(q)] != k)
+						adderrbuf("removeProcQ stress: removed wrong element   ");
+					stressOn[stressIdx(q)] = NOQUEUE;
+					stressLen[k]--;
+				}
+				break;
+		}
+		if(stressCount(k) != stressLen[k])
+			adderrbuf("process queue stress: wrong queue length   ");
+	}
+	for(i = 0; i < MAXPROC; i++) {
+		if(stressOn[i] != NOQUEUE && outProcQ(&stressQ[stressOn[i]], procp[i]) != procp[i])
+			adderrbuf("outProcQ stress: failed to out a member at the end   ");
+		stressOn[i] = NOQUEUE;
+	}
+	for(i = 0; i < STRESSQS; i++)
+		if(!emptyProcQ(stressQ[i]))
+			adderrbuf("outProcQ stress: queue not empty at the end   ");
+	addokbuf("process queue stress test ok   \n");
+
+	/* stress outChild: parents are procp[0..STRESSQS-1], the rest move between them */
+	addokbuf("process tree stress test started   \n");
+	for(i = 0; i < STRESSOPS; i++) {
+		int k = stressRand(STRESSQS);
+		int j = STRESSQS + stressRand(MAXPROC - STRESSQS);
+		switch(stressRand(3)) {
+			case 0:
+				if(stressOn[j] == NOQUEUE) {
+					insertChild(procp[k], procp[j]);
+					stressOn[j] = k;
+				}
+				break;
+			case 1:
+				q = outChild(procp[j]);
+				if(stressOn[j] != NOQUEUE) {
+					if(q != procp[j])
+						adderrbuf("outChild stress: failed to out a child   ");
+					stressOn[j] = NOQUEUE;
+				} else if(q != NULL)
+					adderrbuf("outChild stress: removed an orphan   ");
+				break;
+			default:
+				q = removeChild(procp[k]);
+				if(q != NULL) {
+					if(stressOn[stressIdx(q)] != k)
+						adderrbuf("removeChild stress: removed wrong child   ");
+					stressOn[stressIdx(q)] = NOQUEUE;
+				}
+				break;
+		}
+	}
+	for(i = STRESSQS; i < MAXPROC; i++)
+		if(stressOn[i] != NOQUEUE && outChild(procp[i]) != procp[i])
+			adderrbuf("outChild stress: failed to out a child at the end   ");
+	for(i = 0; i < STRESSQS; i++)
+		if(!emptyChild(procp[i]))
+			adderrbuf("outChild stress: parent not empty at the end   ");
+	addokbuf("process tree stress test ok   \n");
+
+	for(i = 0; i < MAXPROC; i++)
+		freePcb(procp[i]);
+
 	/* check ASL */
 	initASL();
 	addokbuf("Initialized active semaphore list   \n");
@@ -265,8 +408,16 @@ void main() {
 	if(insertBlocked(&sem[11], p))
 		adderrbuf("removeBlocked: fails to return to free list   ");
 
-	if(insertBlocked(&onesem, procp[9]) == FALSE)
-		adderrbuf("insertBlocked: inserted more than MAXPROC   ");
+	/* the semd pool grows by a slab past MAXSEM active semaphores */
+	if((q = allocPcb()) == NULL)
+		adderrbuf("allocPcb: pool did not grow past MAXPROC entries   ");
+	if(insertBlocked(&onesem, q))
+		adderrbuf("insertBlocked: semd pool did not grow past MAXSEM   ");
+	if(semdHighWater() != MAXSEM + 1)
+		adderrbuf("semdHighWater: wrong high-water mark   ");
+	if(removeBlocked(&onesem) != q)
+		adderrbuf("removeBlocked: wrong element from grown semd pool   ");
+	freePcb(q);
 
 	addokbuf("removeBlocked test started   \n");
 	for(i = 10; i < MAXPROC; i++) {
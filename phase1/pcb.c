@@ -3,20 +3,28 @@
  *	This is the implementation of the process queue and process tree module.
  *  The process queues are implemented as doubly, circular linked lists,
  *  with p_prev and p_next fields. And the process queues are pointed by
- *  a tail pointer instead of a head pointer.
+ *  a tail pointer instead of a head pointer. Each pcb also records in
+ *  p_queue the address of the tail pointer of the queue it is on, so
+ *  outProcQ() can check membership and unlink in constant time.
  *
  *  The pcbs are also organized into trees of pcbs, called process trees.
  *  The p_prnt, p_child, and p_sib pointers are used for this purpose.
  *  A parent pcb contains a pointer (p_child) to a single, doubly linearly linked
  *  list of its child pcbs. Each child process has a pointer
  *  to its parent pcb (p_prnt) and the next child pcb of its parent (p_sib).
+ *  Since p_prnt is only set while p is on its parent's child list,
+ *  outChild() also unlinks in constant time.
+ *
+ *  Free pcbs are kept by the slab allocator: the static MAXPROC_pcbs
+ *  table is handed out first, then the pool grows by slabs of free RAM.
  *
  *      Modified by Phuong and Oghap on Feb 2025
  */
 #include "../h/pcb.h"
+#include "../h/slab.h"
 #include "../h/types.h"
 
-HIDDEN pcb_PTR pcbFree_h;
+HIDDEN slabpool_t pcbPool;
 static pcb_t MAXPROC_pcbs[MAXPROC];
 
 /**********************************************************
@@ -29,9 +37,8 @@ static pcb_t MAXPROC_pcbs[MAXPROC];
  *
  */
 void freePcb(pcb_PTR p) {
-	/*adding p to the free pcbFree list*/
-	p->p_next = pcbFree_h;
-	pcbFree_h = p;
+	/*adding p back to the pcb pool*/
+	slabFree(&pcbPool, p);
 }
 
 /**********************************************************
@@ -48,20 +55,19 @@ void freePcb(pcb_PTR p) {
  *
  */
 pcb_PTR allocPcb() {
-	/* Special Case - checking if pcbList empty */
-	if(pcbFree_h == NULL) {
+	/* taking a pcb from the pool, which grows by a slab if needed */
+	pcb_PTR allocatedPcb = slabAlloc(&pcbPool);
+
+	/* Special Case - the pool cannot grow any further */
+	if(allocatedPcb == NULL) {
 		return NULL;
 	}
 
-	/* removing the first p in pcbFree_h */
-	pcb_PTR allocatedPcb = pcbFree_h;
-
-	pcbFree_h = pcbFree_h->p_next;
-
 	/* Provide initial values */
 	allocatedPcb->p_child = NULL;
 	allocatedPcb->p_next = NULL;
 	allocatedPcb->p_prev = NULL;
+	allocatedPcb->p_queue = NULL;
 	allocatedPcb->p_prnt = NULL;
 	allocatedPcb->p_next_sib = NULL;
 	allocatedPcb->p_prev_sib = NULL;
@@ -73,17 +79,24 @@ pcb_PTR allocPcb() {
 	for(i = 0; i < STATEREGNUM; i++) {
 		allocatedPcb->p_s.s_reg[i] = 0;
 	}
-	allocatedPcb->p_time = 0;
+	for(i = 0; i < CPUTIME_BUCKETS; i++) {
+		allocatedPcb->p_time[i] = 0;
+	}
+	allocatedPcb->p_prio = 0;
+	allocatedPcb->p_cpu = NOCPU;
 	allocatedPcb->p_semAdd = NULL;
+	allocatedPcb->p_wakeTime = 0;
+	allocatedPcb->p_timerNext = NULL;
 	allocatedPcb->p_supportStruct = NULL;
 
 	return allocatedPcb;
 }
 
 /**********************************************************
- * Initialize the pcbFree list to contain all the elements of the
- * static array of MAXPROC pcbs. This method will be called only
- * once during data structure initialization.
+ * Initialize the pcb pool to hand out all the elements of the
+ * static array of MAXPROC pcbs before growing by slabs.
+ * This method will be called only once during data structure
+ * initialization.
  *
  *  Parameters:
  *
@@ -92,16 +105,22 @@ pcb_PTR allocPcb() {
  *
  */
 void initPcbs() {
-	/* Start at the head */
-	pcbFree_h = &(MAXPROC_pcbs[0]);
+	/* the static array is the boot table of the pool */
+	initSlabPool(&pcbPool, sizeof(pcb_t), MAXPROC_pcbs, MAXPROC);
+}
 
-	/*  traverse through the static array so that the
-	 *   pcbFree list contains all elements. */
-	int i;
-	for(i = 0; i < MAXPROC - 1; i = i + 1) {
-		(MAXPROC_pcbs[i]).p_next = &(MAXPROC_pcbs[i + 1]);
-	}
-	(MAXPROC_pcbs[i]).p_next = NULL;
+/**********************************************************
+ * Return the most pcbs that were ever allocated at the same time.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *      int - high-water mark of the pcb pool
+ *
+ */
+int pcbHighWater() {
+	return slabHighWater(&pcbPool);
 }
 
 /**********************************************************
@@ -155,6 +174,7 @@ void insertProcQ(pcb_PTR *tp, pcb_PTR p) {
 		(*tp) = p;
 		p->p_next = p;
 		p->p_prev = p;
+		p->p_queue = tp;
 		return;
 	}
 
@@ -164,6 +184,9 @@ void insertProcQ(pcb_PTR *tp, pcb_PTR p) {
 	((*tp)->p_next)->p_prev = p;
 	(*tp)->p_next = p;
 	*tp = p;
+
+	/* Tag p with the queue it is now on */
+	p->p_queue = tp;
 }
 
 /**********************************************************
@@ -197,6 +220,8 @@ pcb_PTR removeProcQ(pcb_PTR *tp) {
 		(*tp) = NULL;
 	}
 
+	rm->p_queue = NULL;
+
 	return rm;
 }
 
@@ -220,14 +245,8 @@ pcb_PTR outProcQ(pcb_PTR *tp, pcb_PTR p) {
 		return NULL;
 	}
 
-	/* find the element p */
-	pcb_PTR traverse = *tp;
-	while((traverse != p) && (traverse->p_next != (*tp))) {
-		traverse = traverse->p_next;
-	}
-
-	/* Special Case - when p is not in the pq */
-	if(traverse != p) {
+	/* Special Case - when p is not in the pq, p_queue tags the queue p is on */
+	if(p->p_queue != tp) {
 		return NULL;
 	}
 
@@ -249,6 +268,7 @@ pcb_PTR outProcQ(pcb_PTR *tp, pcb_PTR p) {
 	/* setting removed pcb values to NULL */
 	p->p_prev = NULL;
 	p->p_next = NULL;
+	p->p_queue = NULL;
 
 	return p;
 }
@@ -386,16 +406,7 @@ pcb_PTR outChild(pcb_PTR p) {
 		return NULL;
 	}
 
-	/* find the element p */
-	pcb_PTR traverse = *tp;
-	while((traverse != p) && (traverse->p_next_sib != (*tp))) {
-		traverse = traverse->p_next_sib;
-	}
-
-	/* Special Case - when p is not in the pq */
-	if(traverse != p) {
-		return NULL;
-	}
+	/* p_prnt is only set while p is on the child list of prnt, so no need to search for it */
 
 	/* remove pcb from the queue */
 	pcb_PTR next = p->p_next_sib;
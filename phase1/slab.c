@@ -0,0 +1,363 @@
+/*********************************SLAB.C*******************************
+ *  Implementation of the Slab Allocator
+ *      Hands out the fixed size kernel objects (pcbs, semaphore
+ *      descriptors, delay descriptors) from pools that can grow past
+ *      their static tables.
+ *
+ *      Each pool first serves the objects of its static boot table, so
+ *      the first MAXPROC objects never depend on free RAM. When the boot
+ *      table is used up, the pool takes a frame of free RAM and carves
+ *      it into a slab: a slab_t header at the start of the frame
+ *      followed by as many objects as fit. Since slabs are page aligned,
+ *      the slab owning an object is found by masking its address.
+ *      A slab whose objects have all been freed is given back to the
+ *      frame list, except for the last slab of a pool, which is kept
+ *      so a pool hovering on a slab boundary does not keep taking and
+ *      returning the same frame.
+ *
+ *      Free frames are the ones between SLAB_RAM_START and the top of
+ *      RAM (from the bus register area) minus SLAB_STACK_RESERVE frames
+ *      left for the stacks placed at RAMTOP.
+ *
+ *      Free objects, slabs and frames are all linked through their
+ *      first word.
+ *      Written by Phuong and Oghap
+ */
+
+#include "../h/slab.h"
+
+#define WORDALIGN(A) (((A) + WORDLEN - 1) & ~(WORDLEN - 1))
+
+/* the frame list is shared by the pools of every processor, the pools
+   themselves are only used under the nucleus lock or a support level mutex */
+#if NCPU > 1
+#include "/usr/include/umps3/umps/libumps.h"
+HIDDEN volatile unsigned int frameLock = 0;
+#define LOCKFRAMES() while(!CAS((unsigned int *)&frameLock, 0, 1))
+#define UNLOCKFRAMES() (frameLock = 0)
+#else
+#define LOCKFRAMES()
+#define UNLOCKFRAMES()
+#endif
+
+HIDDEN int framesReady = FALSE; /* the frame list is set up on the first slab */
+HIDDEN memaddr frameNext;      /* first frame never handed out */
+HIDDEN memaddr frameEnd;       /* first address past the free RAM */
+HIDDEN memaddr *frameFree_h;   /* frames given back by empty slabs */
+HIDDEN int framesInUse;        /* frames currently owned by slabs */
+
+/**********************************************************
+ *  A Helper Function: Compute the free RAM the slabs are taken
+ *  from using the RAM size in the bus register area
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ *
+ */
+HIDDEN void initFrames() {
+	devregarea_t *busRegArea = (devregarea_t *)RAMBASEADDR;
+	frameNext = SLAB_RAM_START;
+	frameEnd = busRegArea->rambase + busRegArea->ramsize - (SLAB_STACK_RESERVE * PAGESIZE);
+	frameFree_h = NULL;
+	framesInUse = 0;
+	framesReady = TRUE;
+}
+
+/**********************************************************
+ *  A Helper Function: Take a frame of free RAM, preferring the
+ *  frames given back by empty slabs
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *         NULL if the free RAM is used up
+ *         memaddr : address of the frame
+ *
+ */
+HIDDEN memaddr allocFrame() {
+	memaddr frame = (memaddr)NULL;
+	LOCKFRAMES();
+	if(!framesReady) {
+		initFrames();
+	}
+	if(frameFree_h != NULL) {
+		frame = (memaddr)frameFree_h;
+		frameFree_h = (memaddr *)(*frameFree_h);
+	} else if(frameNext + PAGESIZE <= frameEnd) {
+		frame = frameNext;
+		frameNext += PAGESIZE;
+	}
+	if(frame != (memaddr)NULL) {
+		framesInUse++;
+	}
+	UNLOCKFRAMES();
+	return frame;
+}
+
+/**********************************************************
+ *  A Helper Function: Give a frame back to the free frame list
+ *
+ *  Parameters:
+ *         memaddr frame : the frame to give back
+ *
+ *  Returns:
+ *
+ *
+ */
+HIDDEN void freeFrame(memaddr frame) {
+	LOCKFRAMES();
+	*((memaddr *)frame) = (memaddr)frameFree_h;
+	frameFree_h = (memaddr *)frame;
+	framesInUse--;
+	UNLOCKFRAMES();
+}
+
+/**********************************************************
+ *  A Helper Function: Insert a slab at the head of a pool list
+ *
+ *  Parameters:
+ *         slab_t **list : address of the head of the list
+ *         slab_t *slab : the slab to insert
+ *
+ *  Returns:
+ *
+ *
+ */
+HIDDEN void insertSlab(slab_t **list, slab_t *slab) {
+	slab->sl_prev = NULL;
+	slab->sl_next = *list;
+	if((*list) != NULL) {
+		(*list)->sl_prev = slab;
+	}
+	*list = slab;
+}
+
+/**********************************************************
+ *  A Helper Function: Remove a slab from anywhere in a pool list
+ *
+ *  Parameters:
+ *         slab_t **list : address of the head of the list
+ *         slab_t *slab : the slab to remove
+ *
+ *  Returns:
+ *
+ *
+ */
+HIDDEN void removeSlab(slab_t **list, slab_t *slab) {
+	if(slab->sl_prev != NULL) {
+		slab->sl_prev->sl_next = slab->sl_next;
+	} else {
+		*list = slab->sl_next;
+	}
+	if(slab->sl_next != NULL) {
+		slab->sl_next->sl_prev = slab->sl_prev;
+	}
+	slab->sl_next = NULL;
+	slab->sl_prev = NULL;
+}
+
+/**********************************************************
+ *  A Helper Function: Take a new frame and carve it into a slab
+ *  for the pool, putting it on the partial list
+ *
+ *  Parameters:
+ *         slabpool_t *pool : the pool to grow
+ *
+ *  Returns:
+ *         NULL if the free RAM is used up
+ *         slab_t *slab : the new slab
+ *
+ */
+HIDDEN slab_t *growPool(slabpool_t *pool) {
+	memaddr frame = allocFrame();
+	if(frame == (memaddr)NULL) {
+		return NULL;
+	}
+	slab_t *slab = (slab_t *)frame;
+	slab->sl_inUse = 0;
+	slab->sl_free = NULL;
+
+	/*chain every object of the frame on the free list of the slab*/
+	memaddr obj = frame + WORDALIGN(sizeof(slab_t));
+	int i;
+	for(i = 0; i < pool->sp_perSlab; i++) {
+		*((void **)obj) = slab->sl_free;
+		slab->sl_free = (void *)obj;
+		obj += pool->sp_objSize;
+	}
+
+	insertSlab(&(pool->sp_partial), slab);
+	pool->sp_slabs++;
+	return slab;
+}
+
+/**********************************************************
+ *  Initialize a pool: chain its static boot table on the boot free
+ *  list and leave it without any slab. Called once per pool at boot.
+ *
+ *  Parameters:
+ *         slabpool_t *pool : the pool to initialize
+ *         int objSize : size in bytes of one object
+ *         void *bootTable : static table of bootCount objects
+ *         int bootCount : number of objects in bootTable
+ *
+ *  Returns:
+ *
+ *
+ */
+void initSlabPool(slabpool_t *pool, int objSize, void *bootTable, int bootCount) {
+	pool->sp_objSize = WORDALIGN(objSize);
+	pool->sp_perSlab = (PAGESIZE - WORDALIGN(sizeof(slab_t))) / pool->sp_objSize;
+	pool->sp_bootBase = (memaddr)bootTable;
+	pool->sp_bootEnd = (memaddr)bootTable + (bootCount * objSize);
+	pool->sp_partial = NULL;
+	pool->sp_full = NULL;
+	pool->sp_slabs = 0;
+	pool->sp_inUse = 0;
+	pool->sp_highWater = 0;
+
+	/*chain the static table in order so objects are handed out from the start of the table*/
+	pool->sp_bootFree = NULL;
+	int i;
+	for(i = bootCount - 1; i >= 0; i--) {
+		void *obj = (void *)((memaddr)bootTable + (i * objSize));
+		*((void **)obj) = pool->sp_bootFree;
+		pool->sp_bootFree = obj;
+	}
+}
+
+/**********************************************************
+ *  Hand out an object of the pool, growing the pool by one slab
+ *  if the boot table and every slab are used up
+ *
+ *  Parameters:
+ *         slabpool_t *pool : the pool to allocate from
+ *
+ *  Returns:
+ *         NULL if the pool cannot grow any further
+ *         void *obj : the allocated object
+ *
+ */
+void *slabAlloc(slabpool_t *pool) {
+	void *obj;
+	if(pool->sp_bootFree != NULL) {
+		/*special case the static table still has free objects*/
+		obj = pool->sp_bootFree;
+		pool->sp_bootFree = *((void **)obj);
+	} else {
+		slab_t *slab = pool->sp_partial;
+		if(slab == NULL) {
+			slab = growPool(pool);
+			if(slab == NULL) {
+				return NULL;
+			}
+		}
+		obj = slab->sl_free;
+		slab->sl_free = *((void **)obj);
+		slab->sl_inUse++;
+		/*move the slab to the full list once its last object is handed out*/
+		if(slab->sl_free == NULL) {
+			removeSlab(&(pool->sp_partial), slab);
+			insertSlab(&(pool->sp_full), slab);
+		}
+	}
+
+	pool->sp_inUse++;
+	if(pool->sp_inUse > pool->sp_highWater) {
+		pool->sp_highWater = pool->sp_inUse;
+	}
+	return obj;
+}
+
+/**********************************************************
+ *  Give an object back to its pool, and the slab owning it back
+ *  to the free frames if that leaves the slab empty
+ *
+ *  Parameters:
+ *         slabpool_t *pool : the pool the object was allocated from
+ *         void *obj : the object to free
+ *
+ *  Returns:
+ *
+ *
+ */
+void slabFree(slabpool_t *pool, void *obj) {
+	pool->sp_inUse--;
+
+	/*special case the object belongs to the static table*/
+	if((memaddr)obj >= pool->sp_bootBase && (memaddr)obj < pool->sp_bootEnd) {
+		*((void **)obj) = pool->sp_bootFree;
+		pool->sp_bootFree = obj;
+		return;
+	}
+
+	/*slabs are page aligned, so the slab header sits at the start of the object's page*/
+	slab_t *slab = (slab_t *)((memaddr)obj & PFN_MASK);
+	if(slab->sl_free == NULL) {
+		removeSlab(&(pool->sp_full), slab);
+		insertSlab(&(pool->sp_partial), slab);
+	}
+	*((void **)obj) = slab->sl_free;
+	slab->sl_free = obj;
+	slab->sl_inUse--;
+
+	/*return the empty slab, unless it is the only one left to the pool*/
+	if(slab->sl_inUse == 0 && pool->sp_slabs > 1) {
+		removeSlab(&(pool->sp_partial), slab);
+		pool->sp_slabs--;
+		freeFrame((memaddr)slab);
+	}
+}
+
+/**********************************************************
+ *  Report the most objects of the pool handed out at once
+ *
+ *  Parameters:
+ *         slabpool_t *pool : the pool to report on
+ *
+ *  Returns:
+ *         int : high-water mark of the pool
+ *
+ */
+int slabHighWater(slabpool_t *pool) {
+	return pool->sp_highWater;
+}
+
+/**********************************************************
+ *  Report the frames of free RAM currently owned by slabs of any pool
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *         int : number of frames in use
+ *
+ */
+int slabFramesInUse() {
+	if(!framesReady) {
+		return 0;
+	}
+	return framesInUse;
+}
+
+/**********************************************************
+ *  Take a frame of free RAM for the nucleus itself, outside of
+ *  any pool. The frame is never given back (used for the nucleus
+ *  stacks of the processors other than processor 0, and for the
+ *  support level block cache).
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *         NULL if the free RAM is used up
+ *         memaddr : address of the frame
+ *
+ */
+memaddr allocKernelFrame() {
+	return allocFrame();
+}
@@ -11,7 +11,7 @@
  *  - exception_handler(): Determines the type of exception and
  *    delegates processing to specialized handlers.
  *  - interrupt_exception_handler(): Handles external device interrupts
- *  - SYSCALL_handler(): Processes system calls (SYS1–SYS8), allowing user processes to
+ *  - SYSCALL_handler(): Processes system calls (SYS1–SYS8, TODWAIT and CPUTIMESPLIT), allowing user processes to
  *    request services such as process management, I/O operations, and clock waiting.
  *  - pass_up_or_die(): Handles program traps and TLB exceptions. If the process
  *    has a support structure, the exception is passed up to the user-level handler;
@@ -91,7 +91,7 @@ HIDDEN void deep_copy_state_t(state_PTR dest, state_PTR src) {
  *  Handles blocking system calls by:
  *  - Incrementing the saved program counter
  *  - Copies the current process state from BIOS
- *  - Updating CPU time
+ *  - Charging the nucleus time of the call
  *  - Calling the scheduler
  *
  *  Parameters:
@@ -103,11 +103,11 @@ HIDDEN void helper_blocking_syscall_handler() {
 	/*
 	This function handle the steps after a blocking handler including:
 	*/
-	((state_PTR)BIOSDATAPAGE)->s_pc += WORDLEN;
+	CPU_EXCSTATE->s_pc += WORDLEN;
 	/* save processor state copy into current process pcb*/
-	deep_copy_state_t(&(currentP->p_s), BIOSDATAPAGE);
-	/*update the cpu time for the current process*/
-	currentP->p_time += (5000 - getTIMER());
+	deep_copy_state_t(&(currentP->p_s), CPU_EXCSTATE);
+	/*charge the time spent servicing the call to the current process*/
+	account_time(CPUTIME_NUCLEUS);
 	/*process was already added to ASL in the syscall =>already blocked*/
 	scheduler();
 }
@@ -117,7 +117,7 @@ HIDDEN void helper_blocking_syscall_handler() {
  *
  *  Handles non-blocking system calls by:
  *  - Incrementing the saved program counter
- *  - Updating CPU time
+ *  - Charging the nucleus time of the call
  *  - Load the process state into BIOS
  *
  *  Parameters:
@@ -127,11 +127,11 @@ HIDDEN void helper_blocking_syscall_handler() {
  **********************************************************/
 HIDDEN void helper_non_blocking_syscall_handler() {
 	/*increment PC by 4*/
-	((state_PTR)BIOSDATAPAGE)->s_pc += WORDLEN;
-	/* update the cpu_time*/
-	currentP->p_time += (5000 - getTIMER());
+	CPU_EXCSTATE->s_pc += WORDLEN;
+	/* charge the time spent servicing the call, the process runs again from now on*/
+	account_time(CPUTIME_NUCLEUS);
 	/*save processor state into the "well known" location for return*/
-	LDST((state_PTR)BIOSDATAPAGE);
+	nucleus_LDST(CPU_EXCSTATE);
 }
 
 /**********************************************************
@@ -150,7 +150,7 @@ HIDDEN int check_KU_mode_bit() {
 	Examines the Status register in the saved exception state.
 	In particular, examine the previous version of the KU bit (KUp)
 	*/
-	int KUp = ((state_PTR)BIOSDATAPAGE)->s_status & 0x00000008;
+	int KUp = CPU_EXCSTATE->s_status & 0x00000008;
 	if(KUp == 0) {
 		return 0;
 	}
@@ -179,7 +179,21 @@ HIDDEN void helper_terminate_process(pcb_PTR toBeTerminate) {
 	}
 	/* make the child no longer child of its parent*/
 	outChild(toBeTerminate);
+#if NCPU > 1
+	/* a process running on another processor is taken away from it, the IPI sends that processor to the scheduler */
+	int cpu;
+	for(cpu = 0; cpu < NCPU; cpu++) {
+		if(cpu != CPUID() && percpu[cpu].pc_currentP == toBeTerminate) {
+			percpu[cpu].pc_currentP = NULL;
+			send_ipi(1 << cpu, IPI_WAKEUP);
+		}
+	}
+#endif
 	pcb_PTR process_unblocked;
+	/* a process sleeping in TODWAIT is soft blocked off the ASL */
+	if(out_timerQ(toBeTerminate) != NULL) {
+		softBlock_count--;
+	}
 	/*if terminated process is not blocked on our device semaphore */
 	if(toBeTerminate->p_semAdd < &device_sem[0] || toBeTerminate->p_semAdd > &device_sem[DEVINTNUM * DEVPERINT + DEVPERINT + 1 - 1]) {
 		process_unblocked = outBlocked(toBeTerminate);
@@ -195,7 +209,7 @@ HIDDEN void helper_terminate_process(pcb_PTR toBeTerminate) {
 		}
 	}
 	/* if this pcb is in readyQ, take it out*/
-	outProcQ(&readyQ, toBeTerminate);
+	out_readyQ(toBeTerminate);
 	/* free the pcb and decrease process count*/
 	freePcb(toBeTerminate);
 	process_count--;
@@ -222,17 +236,17 @@ HIDDEN void CREATEPROCESS() {
 	/* If no more free pcb’s return -1*/
 	if(newProcess == NULL) {
 		/* return an error code of -1 is placed/returned in the caller’s v0 */
-		((state_PTR)BIOSDATAPAGE)->s_v0 = -1;
+		CPU_EXCSTATE->s_v0 = -1;
 		return;
 	}
 
 	/* deep copy the process state where a1 contain a pointer to a processor state (state t) */
-	deep_copy_state_t(&newProcess->p_s, ((state_PTR)BIOSDATAPAGE)->s_a1);
+	deep_copy_state_t(&newProcess->p_s, CPU_EXCSTATE->s_a1);
 
 	/* deep copy the support struct */
 	/* If no parameter is provided, this field is set to NULL. */
-	if(((state_PTR)BIOSDATAPAGE)->s_a2 != NULL & ((state_PTR)BIOSDATAPAGE)->s_a2 != 0) {
-		newProcess->p_supportStruct = ((state_PTR)BIOSDATAPAGE)->s_a2;
+	if(CPU_EXCSTATE->s_a2 != NULL & CPU_EXCSTATE->s_a2 != 0) {
+		newProcess->p_supportStruct = CPU_EXCSTATE->s_a2;
 	} else {
 		newProcess->p_supportStruct = NULL;
 	}
@@ -241,11 +255,11 @@ HIDDEN void CREATEPROCESS() {
 	The process queue fields (e.g. p next) by the call to insertProcQ
 •   The process tree fields (e.g. p child) by the call to insertChild.
 	*/
-	insertProcQ(&readyQ, newProcess);
+	insert_readyQ(newProcess);
 	insertChild(currentP, newProcess);
 
 	/* return the value 0 in the caller’s v0 */
-	((state_PTR)BIOSDATAPAGE)->s_v0 = 0;
+	CPU_EXCSTATE->s_v0 = 0;
 
 	/* increase process count*/
 	process_count++;
@@ -292,7 +306,7 @@ HIDDEN void PASSEREN() {
 	*/
 
 	/* getting the sema4 address from register a1 */
-	int *sema4 = ((state_PTR)BIOSDATAPAGE)->s_a1;
+	int *sema4 = CPU_EXCSTATE->s_a1;
 
 	(*sema4)--;
 
@@ -320,7 +334,7 @@ HIDDEN void PASSEREN() {
  **********************************************************/
 HIDDEN pcb_PTR VERHOGEN() {
 	/*getting the sema4 address from register a1*/
-	int *sema4 = ((state_PTR)BIOSDATAPAGE)->s_a1;
+	int *sema4 = CPU_EXCSTATE->s_a1;
 
 	pcb_PTR process_unblocked;
 	(*sema4)++;
@@ -330,7 +344,7 @@ HIDDEN pcb_PTR VERHOGEN() {
 		if(process_unblocked == NULL) {
 			return NULL;
 		}
-		insertProcQ(&readyQ, process_unblocked);
+		insert_readyQ(process_unblocked);
 		return process_unblocked;
 	}
 	return NULL;
@@ -363,19 +377,23 @@ HIDDEN void WAITIO() {
 	*/
 
 	/* must also update the Cause.IP field bits to show which interrupt lines are pending -- no, the hardware do this*/
-	int device_idx = devSemIdx(((state_PTR)BIOSDATAPAGE)->s_a1, ((state_PTR)BIOSDATAPAGE)->s_a2, ((state_PTR)BIOSDATAPAGE)->s_a3);
+	int device_idx = devSemIdx(CPU_EXCSTATE->s_a1, CPU_EXCSTATE->s_a2, CPU_EXCSTATE->s_a3);
 
 	helper_PASSEREN(&(device_sem[device_idx]));
 
 	softBlock_count++;
 
+	/* an I/O bound process moves up one ready queue level */
+	promote_process(currentP);
+
 	return;
 }
 
 /**********************************************************
  *  GETCPUTIME()
  *
- *  Returns the total CPU time used by the calling process.
+ *  Returns the CPU time used by the calling process: its user
+ *  and nucleus time in v0.
  *
  *  Parameters:
  *
@@ -385,9 +403,35 @@ HIDDEN void WAITIO() {
  **********************************************************/
 
 HIDDEN void GETCPUTIME() {
+	/* include the time of this call up to now */
+	account_time(CPUTIME_NUCLEUS);
 	/*the accumulated processor time (in microseconds) used by the requesting
-	process be placed/returned in the caller’s v0*/
-	((state_PTR)BIOSDATAPAGE)->s_v0 = currentP->p_time + 5000 - getTIMER();
+	process be placed/returned in the caller’s v0, interrupts taken while it ran are not its own*/
+	CPU_EXCSTATE->s_v0 = currentP->p_time[CPUTIME_USER] + currentP->p_time[CPUTIME_NUCLEUS];
+	return;
+}
+
+/**********************************************************
+ *  GETCPUTIMESPLIT()
+ *
+ *  Copies the CPU time buckets of the calling process, user,
+ *  nucleus and interrupt time, to the array of CPUTIME_BUCKETS
+ *  cpu_t a1 points to. Kernel mode only, so a1 is trusted.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void GETCPUTIMESPLIT() {
+	cpu_t *buckets = (cpu_t *)CPU_EXCSTATE->s_a1;
+	int i;
+	/* include the time of this call up to now */
+	account_time(CPUTIME_NUCLEUS);
+	for(i = 0; i < CPUTIME_BUCKETS; i++) {
+		buckets[i] = currentP->p_time[i];
+	}
 	return;
 }
 
@@ -409,12 +453,38 @@ HIDDEN void GETCPUTIME() {
  **********************************************************/
 HIDDEN void WAITCLOCK() {
 	helper_PASSEREN(&(device_sem[pseudo_clock_idx]));
+	/* the tick may have been suppressed while nobody waited for it */
+	clock_rearm();
 
 	softBlock_count++;
 
 	return;
 }
 
+/**********************************************************
+ *  WAITTOD()
+ *
+ *  Blocks the Current Process until the TOD clock reaches
+ *  the time in a1, on the timer queue served by the interval
+ *  timer. A time already passed does not block.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *         int - TRUE if the process blocked
+ **********************************************************/
+HIDDEN int WAITTOD() {
+	cpu_t now;
+	STCK(now);
+	if(CPU_EXCSTATE->s_a1 <= now) {
+		return FALSE;
+	}
+	currentP->p_wakeTime = CPU_EXCSTATE->s_a1;
+	insert_timerQ(currentP);
+	softBlock_count++;
+	return TRUE;
+}
+
 /**********************************************************
  *  GETSUPPORTPTR()
  *
@@ -428,7 +498,7 @@ HIDDEN void WAITCLOCK() {
  *
  **********************************************************/
 HIDDEN void GETSUPPORTPTR() {
-	((state_PTR)BIOSDATAPAGE)->s_v0 = currentP->p_supportStruct;
+	CPU_EXCSTATE->s_v0 = currentP->p_supportStruct;
 }
 
 /**********************************************************
@@ -453,7 +523,10 @@ HIDDEN void pass_up_or_die(int exception_constant) {
 	} else {
 		/* Copy the saved exception state from the BIOS Data Page to the correct sup exceptState field of the Current Process.
 		Perform a LDCXT using the fields from the correct sup exceptContextfield of the Current Process. */
-		deep_copy_state_t(&currentP->p_supportStruct->sup_exceptState[exception_constant], BIOSDATAPAGE);
+		deep_copy_state_t(&currentP->p_supportStruct->sup_exceptState[exception_constant], CPU_EXCSTATE);
+		/* the support level handler runs as the process, charged as user time from now on */
+		account_time(CPUTIME_NUCLEUS);
+		release_nucleus_lock();
 		LDCXT(currentP->p_supportStruct->sup_exceptContext[exception_constant].c_stackPtr, currentP->p_supportStruct->sup_exceptContext[exception_constant].c_status, currentP->p_supportStruct->sup_exceptContext[exception_constant].c_pc);
 		/* NOTE: How did we have the context in the sup_exceptContext in the supportStruct of the current process? */
 	}
@@ -476,9 +549,9 @@ HIDDEN void SYSCALL_handler() {
 	/*int syscall,state_t *statep, support_t * supportp, int arg3*/
 	/*check if in kernel mode -- if not and not SYSCALL 9+ either, put 10 for RI into exec code field in cause register and call program trap exception*/
 	if(check_KU_mode_bit() != 0) {
-		if(((state_PTR)BIOSDATAPAGE)->s_a0 <= 8) {
-			((state_PTR)BIOSDATAPAGE)->s_cause = ((state_PTR)BIOSDATAPAGE)->s_cause | 0x00000028;
-			((state_PTR)BIOSDATAPAGE)->s_cause = ((state_PTR)BIOSDATAPAGE)->s_cause & 0xFFFFFFEB;
+		if(CPU_EXCSTATE->s_a0 <= 8) {
+			CPU_EXCSTATE->s_cause = CPU_EXCSTATE->s_cause | 0x00000028;
+			CPU_EXCSTATE->s_cause = CPU_EXCSTATE->s_cause & 0xFFFFFFEB;
 		}
 
 		/* Program Traps */
@@ -486,7 +559,7 @@ HIDDEN void SYSCALL_handler() {
 		return;
 	}
 
-	switch(((state_PTR)BIOSDATAPAGE)->s_a0) {
+	switch(CPU_EXCSTATE->s_a0) {
 		case 1:
 			CREATEPROCESS();
 			helper_non_blocking_syscall_handler();
@@ -511,6 +584,14 @@ HIDDEN void SYSCALL_handler() {
 		case 8:
 			GETSUPPORTPTR();
 			helper_non_blocking_syscall_handler();
+		case TODWAIT:
+			if(WAITTOD()) {
+				helper_blocking_syscall_handler();
+			}
+			helper_non_blocking_syscall_handler();
+		case CPUTIMESPLIT:
+			GETCPUTIMESPLIT();
+			helper_non_blocking_syscall_handler();
 		default:
 			/* Syscall Exception Error - Program trap handler */
 			pass_up_or_die(GENERALEXCEPT);
@@ -522,7 +603,8 @@ HIDDEN void SYSCALL_handler() {
  *
  *  Determines the cause of an exception and delegates it to
  *  the corresponding handler (interrupt, TLB exception, program
- *  trap, or system call).
+ *  trap, or system call). Takes the nucleus lock, which the
+ *  handlers release when they leave the nucleus.
  *
  *  Parameters:
  *
@@ -531,10 +613,21 @@ HIDDEN void SYSCALL_handler() {
  *
  **********************************************************/
 void exception_handler() {
+	/* the nucleus data is shared by every processor, released when leaving the nucleus */
+	acquire_nucleus_lock();
+
 	/* Get the Cause registers from the saved exception state and
 	use AND bitwise operation to get the .ExcCode field */
 	/* decodes Cause.ExcCode */
-	int ExcCode = CauseExcCode(((state_PTR)BIOSDATAPAGE)->s_cause);
+	int ExcCode = CauseExcCode(CPU_EXCSTATE->s_cause);
+
+	/* the Current Process ran until now, the nucleus or interrupt time starts here */
+	account_time(CPUTIME_USER);
+
+	/* the process running here was terminated by another processor before its IPI arrived */
+	if(currentP == NULL && ExcCode != INT) {
+		scheduler();
+	}
 
 	switch(ExcCode) {
 		case INT:
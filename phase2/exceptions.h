@@ -10,8 +10,9 @@
 
 extern int process_count;                                     /* Number of started processes */
 extern int softBlock_count;                                   /* Number of started that are in blocked */
-extern pcb_PTR readyQ;                                        /* Tail ptr to a queue of pcbs that are ready */
-extern pcb_PTR currentP;                                      /* Current Process */
+extern percpu_t percpu[NCPU];                                 /* Ready queues and Current Process of each processor */
+#define currentP (percpu[CPUID()].pc_currentP)               /* Current Process of the calling processor */
+#define currentQuantum (percpu[CPUID()].pc_quantum)          /* PLT quantum the Current Process was dispatched with */
 extern int device_sem[DEVINTNUM * DEVPERINT + DEVPERINT + 1]; /* Device Semaphores 49 semaphores in an array */
 
 extern void uTLB_RefillHandler();
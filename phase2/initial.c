@@ -11,6 +11,9 @@
  *  - Initializing the Active Semaphore List (ASL) and Process Queue.
  *  - Instantiating the first process and placing it in the Ready Queue.
  *  - Loading the system-wide Interval Timer.
+ *  - With NCPU > 1, routing the device interrupts to every processor
+ *    and starting the other processors, each with its own Pass Up
+ *    Vector and nucleus stack.
  *  - Ensuring the system enters the scheduler for process execution.
  *
  *      Modified by Phuong and Oghap on Feb 2025
@@ -21,19 +24,70 @@
 #include "../h/pcb.h"
 #include "../h/asl.h"
 #include "../h/types.h"
+#include "../h/slab.h"
 
 #include "exceptions.h"
 #include "scheduler.h"
+#include "interrupts.h"
 
 #include "initial.h"
 
 /* global variables*/
 int process_count;                                     /* Number of started processes */
 int softBlock_count;                                   /* Number of started that are in blocked */
-pcb_PTR readyQ;                                        /* Tail ptr to a queue of pcbs that are ready */
-pcb_PTR currentP;                                      /* Current Process */
+percpu_t percpu[NCPU];                                 /* Ready queues and Current Process of each processor */
 int device_sem[DEVINTNUM * DEVPERINT + DEVPERINT + 1]; /* Device Semaphores 49 semaphores in an array */
 
+/**********************************************************
+ *  start_cpus()
+ *
+ *  Gives every processor but processor 0 a Pass Up Vector and
+ *  a nucleus stack taken from free RAM, routes the device
+ *  interrupts to the least busy processor, and starts the
+ *  processors in cpu_start(). Does nothing on a uniprocessor.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ *
+ **********************************************************/
+HIDDEN void start_cpus() {
+#if NCPU > 1
+	int i;
+	int cpu;
+	state_t startState;
+
+	/* any processor may take any device interrupt */
+	for(i = 0; i < IRT_ENTRIES; i++) {
+		*((memaddr *)(IRT_BASE + (i * WORDLEN))) = IRT_DYNAMIC | ((1 << NCPU) - 1);
+	}
+
+	for(cpu = 1; cpu < NCPU; cpu++) {
+		memaddr stack = allocKernelFrame();
+		if(stack == (memaddr)NULL) {
+			PANIC();
+		}
+		percpu[cpu].pc_stackTop = stack + PAGESIZE;
+
+		passupvector_t *passup = ((passupvector_t *)PASSUPVECTOR) + cpu;
+		passup->tlb_refll_handler = (memaddr)uTLB_RefillHandler;
+		passup->tlb_refll_stackPtr = percpu[cpu].pc_stackTop;
+		passup->exception_handler = (memaddr)exception_handler;
+		passup->exception_stackPtr = percpu[cpu].pc_stackTop;
+
+		/* kernel mode, interrupts and PLT off until the scheduler loads a process or idles */
+		startState.s_status = ALLOFF;
+		startState.s_pc = (memaddr)cpu_start;
+		startState.s_t9 = (memaddr)cpu_start;
+		startState.s_sp = percpu[cpu].pc_stackTop;
+		startState.s_entryHI = 0;
+		INITCPU(cpu, &startState);
+	}
+#endif
+}
+
 /**********************************************************
  *  main()
  *
@@ -50,6 +104,7 @@ int device_sem[DEVINTNUM * DEVPERINT + DEVPERINT + 1]; /* Device Semaphores 49 s
  *
  **********************************************************/
 void main() {
+	int i;
 	/* Populate the pass up vector */
 	passupvector_t *passup_pro0 = (passupvector_t *)PASSUPVECTOR;
 	passup_pro0->tlb_refll_handler = (memaddr)uTLB_RefillHandler;
@@ -67,22 +122,27 @@ void main() {
 	/* Initialize all Nucleus maintained variables */
 	process_count = 0;
 	softBlock_count = 0;
-	readyQ = mkEmptyProcQ();
-	currentP = NULL;
+	init_readyQ();
+	for(i = 0; i < NCPU; i++) {
+		percpu[i].pc_currentP = NULL;
+		percpu[i].pc_quantum = MLFQ_BASE_QUANTUM;
+		percpu[i].pc_idle = FALSE;
+	}
+	percpu[0].pc_stackTop = RAMSTART + PAGESIZE;
+	init_interrupt_counters();
 
 	/* Initalizing device semaphores to 0 */
-	int i;
 	int numberOfSemaphores = DEVINTNUM * DEVPERINT + DEVPERINT + 1;
 	for(i = 0; i < numberOfSemaphores; i++) {
 		device_sem[i] = 0;
 	}
 
 	/* Load the system-wide Interval Timer with 100 milliseconds */
-	LDIT(CLOCKINTERVAL);
+	init_interval_timer();
 
 	/* Instantiate a single process, place its pcb in the Ready Queue, and increment Process Count. */
 	pcb_PTR first_pro = allocPcb();
-	insertProcQ(&readyQ, first_pro);
+	insert_readyQ(first_pro);
 	process_count++;
 
 	/*  Interrupts enabled
@@ -105,6 +165,10 @@ void main() {
 
 	    COMPLETED in pcb.c */
 
+	/* Start the other processors, they find first_pro or idle until work is queued for them */
+	start_cpus();
+
 	/* Call the Scheduler */
+	acquire_nucleus_lock();
 	scheduler();
 }
@@ -2,14 +2,18 @@
  *  Interrupt Handling Module
  *
  *  This module handles system interrupts.
- *  There are three main types: processor local timer (PLT), pseudo-clock,
- *  and device interrupts. The function interrupt_exception_handler()
+ *  There are four main types: inter-processor (IPI), processor local
+ *  timer (PLT), pseudo-clock, and device interrupts. The function interrupt_exception_handler()
  *  checks which interrupt occurred and calls the right function.
  *
  *  The code uses functions to handle different types of interrupts.
  *  process_local_timer_interrupts() manages the PLT by resetting the timer
  *  and putting the current process back in the ready queue.
- *  pseudo_clock_interrupts() updates the pseudo-clock and unblocks waiting processes.
+ *  pseudo_clock_interrupts() updates the pseudo-clock, wakes the processes whose
+ *  TODWAIT deadline passed and loads the interval timer for the earlier of the next
+ *  pseudo-clock tick and the next deadline. TODWAIT sleepers hang on a hierarchical
+ *  timer wheel in O(1); only the few due within the current wheel tick are kept
+ *  sorted on timerQ, so the interval timer still fires on the exact deadline.
  *  non_timer_interrupts() checks which device caused an interrupt and processes it.
  *  It also has special handling for terminal devices using  helper_terminal_device()  and
  *  helper_non_terminal_device() .
@@ -36,6 +40,41 @@
 #define IPBITSPOS 8         /* Interrupt pending bits position*/
 #define INTLINESCOUNT 8     /* number of interrupt lines*/
 #define REGWIDTH 32         /* register width*/
+#define STATUSCODEMASK 0x000000FF /* status code field of a device (or sub-device) status*/
+#define NOTIME -1           /* no TOD or wheel tick due */
+
+int intServiced[INTLINESCOUNT];  /* device interrupts handled, per line */
+int intCoalesced[INTLINESCOUNT]; /* of which were handled in an entry that had already handled one */
+HIDDEN int servicedThisEntry;    /* device interrupts handled since entering the handler */
+HIDDEN pcb_PTR timerQ;           /* TODWAIT sleepers due by the end of wheel tick wheelNow, earliest deadline first */
+HIDDEN pcb_PTR timerWheel[WHEEL_LEVELS][WHEEL_SLOTS]; /* later TODWAIT sleepers, one list per slot */
+HIDDEN int timerWheelCount[WHEEL_LEVELS];             /* sleepers on each level of timerWheel */
+HIDDEN cpu_t wheelNow;           /* last wheel tick whose sleepers were moved onto timerQ */
+HIDDEN cpu_t nextClockTick;      /* TOD of the next pseudo-clock tick */
+HIDDEN int clockArmed;           /* FALSE while the pseudo-clock tick is suppressed */
+int clockTicksSkipped;           /* pseudo-clock ticks suppressed while idle */
+volatile unsigned int tlbFlushGen[NCPU]; /* IPI_TLBFLUSH served by each processor, polled by a shootdown */
+
+/**********************************************************
+ *  init_interrupt_counters()
+ *
+ *  Resets the per line interrupt counters. Called once by main().
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void init_interrupt_counters() {
+	int i;
+	for(i = 0; i < INTLINESCOUNT; i++) {
+		intServiced[i] = 0;
+		intCoalesced[i] = 0;
+	}
+	for(i = 0; i < NCPU; i++) {
+		tlbFlushGen[i] = 0;
+	}
+}
 
 /**********************************************************
  *  helper_verhogen()
@@ -45,14 +84,12 @@
  *  the ready queue.
  *
  *  Parameters:
+ *         int *sema4 - semaphore to V
  *
  *  Returns:
  *         pcb_PTR - Pointer to the unblocked process
  **********************************************************/
-pcb_PTR helper_verhogen() {
-	/*getting the sema4 address from register a1*/
-	int *sema4 = ((state_PTR)BIOSDATAPAGE)->s_a1;
-
+HIDDEN pcb_PTR helper_verhogen(int *sema4) {
 	pcb_PTR process_unblocked;
 	(*sema4)++;
 
@@ -61,7 +98,7 @@ pcb_PTR helper_verhogen() {
 		if(process_unblocked == NULL) {
 			return NULL;
 		}
-		insertProcQ(&readyQ, process_unblocked);
+		insert_readyQ(process_unblocked);
 		return process_unblocked;
 	}
 	return NULL;
@@ -107,7 +144,7 @@ HIDDEN void deep_copy_state_t(state_PTR dest, state_PTR src) {
 HIDDEN int helper_check_interrupt_line(int idx) {
 	/* Get the IP bit from cause registers then shift right to get the interrupt line which*/
 	/* in binary, 1 bits indicate line with interrupt pending -- this is Cause.IP*/
-	int IPLines = (((state_PTR)BIOSDATAPAGE)->s_cause & IPBITS) >> IPBITSPOS;
+	int IPLines = (CPU_EXCSTATE->s_cause & IPBITS) >> IPBITSPOS;
 
 	/* 31 as the size of int is 32 bits (4 bytes)*/
 	if((IPLines << (REGWIDTH - 1 - idx)) >> (REGWIDTH - 1) == 0) {
@@ -164,12 +201,65 @@ HIDDEN pcb_PTR helper_unblock_process(int *semdAdd) {
 	return unblocked_pcb;
 }
 
+/**********************************************************
+ *  helper_device_done()
+ *
+ *  Performs a V operation on the Nucleus maintained semaphore
+ *  of an acknowledged (sub)device. The unblocked process, if
+ *  any, gets the saved status code in v0 and is moved to the
+ *  ready queue. Counts the interrupt for its line.
+ *
+ *  Parameters:
+ *         int intLineNo - Interrupt line number
+ *         int devIdx - index of the (sub)device semaphore
+ *         int savedDevRegStatus - status code before the ACK
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_device_done(int intLineNo, int devIdx, int savedDevRegStatus) {
+	/* putting the process returned by V operation to unblocked_pcb, already on the Ready Queue */
+	pcb_PTR unblocked_pcb = helper_verhogen(&device_sem[devIdx]);
+
+	if(unblocked_pcb != NULL) {
+		softBlock_count--;
+		/* Place the stored off status code in the newly unblocked pcb’s v0 register.*/
+		unblocked_pcb->p_s.s_v0 = savedDevRegStatus;
+	}
+
+	/* every interrupt after the first of an entry saved a trip through the handler*/
+	intServiced[intLineNo]++;
+	if(servicedThisEntry > 0) {
+		intCoalesced[intLineNo]++;
+	}
+	servicedThisEntry++;
+}
+
+/**********************************************************
+ *  helper_subdevice_pending()
+ *
+ *  Tells whether a (sub)device status holds a completion the
+ *  nucleus has not acknowledged yet: anything other than
+ *  not installed, ready or busy.
+ *
+ *  Parameters:
+ *         unsigned int status - device or sub-device status field
+ *
+ *  Returns:
+ *          TRUE
+ *          FALSE
+ **********************************************************/
+HIDDEN int helper_subdevice_pending(unsigned int status) {
+	int code = status & STATUSCODEMASK;
+	return code != UNINSTALLED && code != READY && code != BUSY;
+}
+
 /**********************************************************
  *  helper_terminal_device()
  *
- *  Acknowledge interrupts from terminal read sub-device.
- *  Performs a V operation on the device semaphore
- *  and unblocks waiting process if needed
+ *  Acknowledges every pending half of a terminal: the
+ *  transmitter first (higher priority), then the receiver,
+ *  and performs a V operation on each of their semaphores.
  *
  *  Parameters:
  *         int intLineNo - Interrupt line number
@@ -178,63 +268,36 @@ HIDDEN pcb_PTR helper_unblock_process(int *semdAdd) {
  *  Returns:
  *
  **********************************************************/
-HIDDEN void helper_terminal_device(int intLineNo, int devNo, int termRead) {
+HIDDEN void helper_terminal_device(int intLineNo, int devNo) {
 	/* Calculate the address for this device’s device register */
 	device_t *intDevRegAdd = devAddrBase(intLineNo, devNo);
 	int savedDevRegStatus;
+	int devIdx;
 
-	if(termRead) {
-		/* Save off the status code from the device’s device register*/
-		savedDevRegStatus = intDevRegAdd->t_recv_status; /* should be the char and 5 for CHAR RECEIVED*/ /* we want this because after acknowledged, anything will become Device Ready, even if the action did not succeed*/
-		/* Acknowledge the outstanding interrupt */
-		intDevRegAdd->t_recv_command = ACK;
-	} else {
-		/* Save off the status code from the device’s device register*/
-		savedDevRegStatus = intDevRegAdd->t_transm_status; /* should be the char and 5 for CHAR TRANSMITTED*/ /* we want this because after acknowledged, anything will become Device Ready, even if the action did not succeed*/
+	if(helper_subdevice_pending(intDevRegAdd->t_transm_status)) {
+		/* Save off the status code, after acknowledged it becomes Device Ready even if the action did not succeed*/
+		savedDevRegStatus = intDevRegAdd->t_transm_status;
 		/* Acknowledge the outstanding interrupt */
 		intDevRegAdd->t_transm_command = ACK;
+		devIdx = devSemIdx(intLineNo, devNo, FALSE);
+		helper_device_done(intLineNo, devIdx, savedDevRegStatus);
 	}
 
-	/* Perform a V operation on the Nucleus maintained semaphore associated with this (sub)device.*/
-	int devIdx = devSemIdx(intLineNo, devNo, termRead);
-
-	/* put semdAdd into BIOSDATAPAGE state register a1 to call VERHOGEN -- VERHOGEN use the state in currentP*/
-	((state_PTR)BIOSDATAPAGE)->s_a1 = &device_sem[devIdx];
-
-	/* putting the process returned by V operation to unblocked_pcb */
-	pcb_PTR unblocked_pcb = helper_verhogen();
-
-	/* if V operation failed to remove a pcb then return control to the current process*/
-	if(unblocked_pcb == NULL) {
-		/* if there is no current process to return to either, call scheduler*/
-		if(currentP == NULL) {
-			scheduler();
-		}
-		LDST((state_PTR)BIOSDATAPAGE);
-	}
-	softBlock_count--;
-
-	/* Place the stored off status code in the newly unblocked pcb’s v0 register.*/
-	unblocked_pcb->p_s.s_v0 = savedDevRegStatus;
-
-	/* Insert the newly unblocked pcb on the Ready Queue*/
-	/* Done in helper_verhogen()*/
-	/* if there is no current process to return to either, call scheduler*/
-	if(currentP == NULL) {
-		scheduler();
+	if(helper_subdevice_pending(intDevRegAdd->t_recv_status)) {
+		/* Save off the status code (the char and 5 for CHAR RECEIVED)*/
+		savedDevRegStatus = intDevRegAdd->t_recv_status;
+		/* Acknowledge the outstanding interrupt */
+		intDevRegAdd->t_recv_command = ACK;
+		devIdx = devSemIdx(intLineNo, devNo, TRUE);
+		helper_device_done(intLineNo, devIdx, savedDevRegStatus);
 	}
-	/* Perform a LDST on the saved exception state*/
-	LDST((state_PTR)BIOSDATAPAGE);
 }
 
 /**********************************************************
  *  helper_non_terminal_device()
  *
- *  Aknowledge interrupts from terminal write sub-device
- *  or other devices. Performs a V operation on the device
- *  semaphore and unblocks waiting process if needed.
- *  When V operation fails to remove a pcb, it
- *  returns control to the current process.
+ *  Acknowledges the interrupt of a device other than a
+ *  terminal and performs a V operation on its semaphore.
  *
  *  Parameters:
  *         int intLineNo - Interrupt line number
@@ -253,73 +316,380 @@ HIDDEN void helper_non_terminal_device(int intLineNo, int devNo) {
 	/* Acknowledge the outstanding interrupt */
 	intDevRegAdd->d_command = ACK;
 
-	/* Perform a V operation on the Nucleus maintained semaphore associated with this (sub)device.*/
 	int devIdx = devSemIdx(intLineNo, devNo, FALSE);
+	helper_device_done(intLineNo, devIdx, savedDevRegStatus);
+}
+
+/* Interrupts */
+
+/**********************************************************
+ *  process_local_timer_interrupts()
+ *
+ *  Acknowledges the PLT and copies the processor state from
+ *  BIOS. The current process used its whole quantum: closes
+ *  its time accounting, demotes it one ready queue level and moves it to the
+ *  ready queue. The processor is left without a Current Process,
+ *  so the handler calls the scheduler once every line is drained.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void process_local_timer_interrupts() {
+	/* load new time into timer for PLT to acknowledge the interrupt, scheduler sets the next quantum*/
+	setTIMER(currentQuantum);
+	/* the process was terminated by another processor, nothing to charge*/
+	if(currentP == NULL) {
+		return;
+	}
+	/* copy the processor state at the time of the exception into current process*/
+	deep_copy_state_t(&(currentP->p_s), CPU_EXCSTATE);
+	/* the quantum ran out: close the interrupt time of the current process before it leaves the processor*/
+	account_time(CPUTIME_INTERRUPT);
+	/* full quantum used: one level down, then place current process on ready queue*/
+	demote_process(currentP);
+	insert_readyQ(currentP);
+	currentP = NULL;
+}
+
+/**********************************************************
+ *  inter_processor_interrupts()
+ *
+ *  Acknowledges an IPI. An IPI_TLBFLUSH clears the TLB of this
+ *  processor, then bumps its tlbFlushGen so the processor that
+ *  sent it knows the TLB is clean; an IPI_WAKEUP needs no work of its own, the caller
+ *  enters the scheduler if this processor has no Current Process.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void inter_processor_interrupts() {
+	int msg = *((memaddr *)IPI_INBOX) & IPI_MSGMASK;
+	/* acknowledge the message, the next pending one (if any) moves to the inbox*/
+	*((memaddr *)IPI_INBOX) = ACK;
+	if(msg == IPI_TLBFLUSH) {
+		TLBCLR();
+		tlbFlushGen[CPUID()]++;
+	}
+}
 
-	/* put semdAdd into BIOSDATAPAGE state register a1 to call VERHOGEN -- VERHOGEN use the semdAdd in reg a1 of the state saved*/
-	((state_PTR)BIOSDATAPAGE)->s_a1 = &device_sem[devIdx];
+/**********************************************************
+ *  helper_wheel_hang()
+ *
+ *  Hangs a TODWAIT sleeper on the timer wheel slot covering
+ *  its deadline, or on timerQ, sorted, once its deadline falls
+ *  within wheel tick wheelNow. A deadline beyond the wheel is
+ *  parked on the furthest slot and hung again from there.
+ *
+ *  Parameters:
+ *         pcb_PTR p - process with p_wakeTime set
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_wheel_hang(pcb_PTR p) {
+	cpu_t expiry = p->p_wakeTime / WHEEL_TICK;
+	int level = 0;
+	pcb_PTR *link = &timerQ;
+	if(expiry <= wheelNow) {
+		while(*link != NULL && (*link)->p_wakeTime <= p->p_wakeTime) {
+			link = &((*link)->p_timerNext);
+		}
+	} else {
+		if(expiry - wheelNow >= WHEEL_SPAN) {
+			expiry = wheelNow + WHEEL_SPAN - 1;
+		}
+		while(level < WHEEL_LEVELS - 1 && (expiry - wheelNow) >= (1 << (WHEEL_BITS * (level + 1)))) {
+			level++;
+		}
+		link = &(timerWheel[level][(expiry >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)]);
+		timerWheelCount[level]++;
+	}
+	p->p_timerNext = *link;
+	*link = p;
+}
 
-	/* putting the process returned by V operation to unblocked_pcb */
-	pcb_PTR unblocked_pcb = helper_verhogen();
+/**********************************************************
+ *  helper_wheel_next()
+ *
+ *  Finds the first wheel tick after wheelNow at which a slot
+ *  is due: a level 0 slot moves onto timerQ, an upper level
+ *  slot cascades down. Looks at most at WHEEL_SLOTS slots of
+ *  each level that has a sleeper.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *         cpu_t - the wheel tick, NOTIME if the wheel is empty
+ **********************************************************/
+HIDDEN cpu_t helper_wheel_next() {
+	cpu_t next = NOTIME;
+	cpu_t block;
+	int level;
+	int k;
+	for(level = 0; level < WHEEL_LEVELS; level++) {
+		if(timerWheelCount[level] == 0) {
+			continue;
+		}
+		block = wheelNow >> (WHEEL_BITS * level);
+		for(k = 1; k <= WHEEL_SLOTS; k++) {
+			if(timerWheel[level][(block + k) & (WHEEL_SLOTS - 1)] != NULL) {
+				if(next == NOTIME || ((block + k) << (WHEEL_BITS * level)) < next) {
+					next = (block + k) << (WHEEL_BITS * level);
+				}
+				break;
+			}
+		}
+	}
+	return next;
+}
 
-	/* if V operation failed to remove a pcb then return control to the current process*/
-	if(unblocked_pcb == NULL) {
-		/* if there is no current process to return to either, call scheduler*/
-		if(currentP == NULL) {
-			scheduler();
+/**********************************************************
+ *  helper_wheel_advance()
+ *
+ *  Moves the timer wheel up to the wheel tick of now, jumping
+ *  straight between the ticks at which a slot is due. At each
+ *  of them the upper level slots starting there cascade down,
+ *  then the level 0 slot moves onto timerQ.
+ *
+ *  Parameters:
+ *         cpu_t now - current TOD
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_wheel_advance(cpu_t now) {
+	cpu_t nowTick = now / WHEEL_TICK;
+	cpu_t next;
+	pcb_PTR due;
+	pcb_PTR p;
+	int level;
+	while(wheelNow < nowTick) {
+		next = helper_wheel_next();
+		if(next == NOTIME || next > nowTick) {
+			wheelNow = nowTick;
+			return;
+		}
+		wheelNow = next;
+		for(level = WHEEL_LEVELS - 1; level >= 0; level--) {
+			if((wheelNow & ((1 << (WHEEL_BITS * level)) - 1)) == 0) {
+				due = timerWheel[level][(wheelNow >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+				timerWheel[level][(wheelNow >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)] = NULL;
+				while(due != NULL) {
+					p = due;
+					due = p->p_timerNext;
+					timerWheelCount[level]--;
+					helper_wheel_hang(p);
+				}
+			}
 		}
-		LDST((state_PTR)BIOSDATAPAGE);
 	}
-	softBlock_count--;
+}
 
-	/* Place the stored off status code in the newly unblocked pcb’s v0 register.*/
-	unblocked_pcb->p_s.s_v0 = savedDevRegStatus;
+/**********************************************************
+ *  helper_load_interval_timer()
+ *
+ *  Loads the interval timer for the earliest of the next
+ *  pseudo-clock tick, unless it is suppressed, the first
+ *  deadline on timerQ and the next wheel tick with a slot due.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_load_interval_timer() {
+	cpu_t now;
+	cpu_t next = NOTIME;
+	cpu_t wheelNext = helper_wheel_next();
+	STCK(now);
+	if(clockArmed) {
+		next = nextClockTick;
+	}
+	if(timerQ != NULL && (next == NOTIME || timerQ->p_wakeTime < next)) {
+		next = timerQ->p_wakeTime;
+	}
+	if(wheelNext != NOTIME && (next == NOTIME || wheelNext * WHEEL_TICK < next)) {
+		next = wheelNext * WHEEL_TICK;
+	}
+	if(next == NOTIME) {
+		/* nothing to wait for: the timer is left to count down from its largest value */
+		*((unsigned int *)INTERVALTMR) = INTERVALTMR_IDLE;
+		return;
+	}
+	/* a deadline already passed still needs an interrupt to be served */
+	LDIT(MAX(next - now, 1));
+}
 
-	/* Insert the newly unblocked pcb on the Ready Queue*/
-	/* Done in helper_verhogen()*/
+/**********************************************************
+ *  init_interval_timer()
+ *
+ *  Empties the timer queue and starts the pseudo-clock.
+ *  Called once by main().
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void init_interval_timer() {
+	int level;
+	int slot;
+	timerQ = NULL;
+	for(level = 0; level < WHEEL_LEVELS; level++) {
+		timerWheelCount[level] = 0;
+		for(slot = 0; slot < WHEEL_SLOTS; slot++) {
+			timerWheel[level][slot] = NULL;
+		}
+	}
+	clockArmed = TRUE;
+	clockTicksSkipped = 0;
+	STCK(nextClockTick);
+	wheelNow = nextClockTick / WHEEL_TICK;
+	nextClockTick += CLOCKINTERVAL;
+	LDIT(CLOCKINTERVAL);
+}
 
-	if(currentP == NULL) {
-		scheduler();
+/**********************************************************
+ *  clock_idle()
+ *
+ *  Called by a processor about to WAIT(). When nobody waits
+ *  on the pseudo-clock and no ready process could need an
+ *  anti-starvation boost, suppresses the pseudo-clock tick so
+ *  the idle processors are woken only by a device or a
+ *  TODWAIT deadline.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void clock_idle() {
+	int cpu;
+	if(!clockArmed || device_sem[pseudo_clock_idx] < 0) {
+		return;
 	}
-	/* Perform a LDST on the saved exception state*/
-	LDST((state_PTR)BIOSDATAPAGE);
+	for(cpu = 0; cpu < NCPU; cpu++) {
+		if(percpu[cpu].pc_readyBitmap != 0) {
+			return;
+		}
+	}
+	clockArmed = FALSE;
+	helper_load_interval_timer();
 }
 
-/* Interrupts */
+/**********************************************************
+ *  clock_rearm()
+ *
+ *  Restarts a suppressed pseudo-clock tick, on the first tick
+ *  boundary still to come, so the tick keeps its phase.
+ *  Called by WAITCLOCK and when a processor dispatches with
+ *  other processes still ready.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void clock_rearm() {
+	cpu_t now;
+	if(clockArmed) {
+		return;
+	}
+	clockArmed = TRUE;
+	STCK(now);
+	while(nextClockTick <= now) {
+		nextClockTick += CLOCKINTERVAL;
+		clockTicksSkipped++;
+	}
+	helper_load_interval_timer();
+}
 
 /**********************************************************
- *  process_local_timer_interrupts()
+ *  insert_timerQ()
  *
- *  Resets timer to 5 miliseconds and copies the processor
- *  state from BIOS. Updates CPU time and moves the
- *  current process to the ready queue, then calls
- *  scheduler.
+ *  Puts a process on the timer wheel in O(1), once the wheel
+ *  caught up with the TOD, and reloads the interval timer.
  *
  *  Parameters:
+ *         pcb_PTR p - process with p_wakeTime set
  *
  *  Returns:
  *
  **********************************************************/
-HIDDEN void process_local_timer_interrupts() {
-	/* load new time into timer for PLT*/
-	setTIMER(5000);
-	/* copy the processor state at the time of the exception into current process*/
-	if(currentP != NULL) {
-		deep_copy_state_t(&(currentP->p_s), (state_PTR)BIOSDATAPAGE);
-	}
-	/* update accumulated CPU time for the current process*/
-	currentP->p_time += 5000 - getTIMER();
-	/* place current process on ready queue*/
-	insertProcQ(&readyQ, currentP);
-	scheduler();
+void insert_timerQ(pcb_PTR p) {
+	cpu_t now;
+	STCK(now);
+	helper_wheel_advance(now);
+	helper_wheel_hang(p);
+	helper_load_interval_timer();
+}
+
+/**********************************************************
+ *  helper_timer_unlink()
+ *
+ *  Takes a process off one list of sleepers, if it is there.
+ *
+ *  Parameters:
+ *         pcb_PTR *link - head of the list
+ *         pcb_PTR p - process to remove
+ *
+ *  Returns:
+ *         int - TRUE if p was on the list
+ **********************************************************/
+HIDDEN int helper_timer_unlink(pcb_PTR *link, pcb_PTR p) {
+	while(*link != NULL && *link != p) {
+		link = &((*link)->p_timerNext);
+	}
+	if(*link == NULL) {
+		return FALSE;
+	}
+	*link = p->p_timerNext;
+	p->p_timerNext = NULL;
+	return TRUE;
+}
+
+/**********************************************************
+ *  out_timerQ()
+ *
+ *  Takes a process off timerQ or the timer wheel. Only needed
+ *  when a sleeper is terminated, so it simply looks through
+ *  every list.
+ *
+ *  Parameters:
+ *         pcb_PTR p - process to remove
+ *
+ *  Returns:
+ *         pcb_PTR - p, or NULL if it was not sleeping in TODWAIT
+ **********************************************************/
+pcb_PTR out_timerQ(pcb_PTR p) {
+	int level;
+	int slot;
+	if(helper_timer_unlink(&timerQ, p)) {
+		return p;
+	}
+	for(level = 0; level < WHEEL_LEVELS; level++) {
+		for(slot = 0; slot < WHEEL_SLOTS; slot++) {
+			if(helper_timer_unlink(&(timerWheel[level][slot]), p)) {
+				timerWheelCount[level]--;
+				return p;
+			}
+		}
+	}
+	return NULL;
 }
 
 /**********************************************************
  *  pseudo_clock_interrupts()
  *
- *  Reloads timer and unblocks all pcb that was blocked on
- *  pseudo-clock. Resets the psuedo-clock semaphore and
- *  returns control to the current process.
+ *  Serves the interval timer. Once the pseudo-clock tick is
+ *  due, unblocks all pcb that was blocked on pseudo-clock and
+ *  resets the psuedo-clock semaphore; the next tick keeps the
+ *  phase of the previous ones. Wakes every TODWAIT sleeper
+ *  whose deadline passed, then reloads the timer.
  *
  *  Parameters:
  *
@@ -327,30 +697,42 @@ HIDDEN void process_local_timer_interrupts() {
  *
  **********************************************************/
 HIDDEN void pseudo_clock_interrupts() {
-	/* load interval timer with 100 miliseconds*/
-	LDIT(100000);
-	int *pseudo_clock_sem = &(device_sem[pseudo_clock_idx]);
-	pcb_PTR unblocked_pcb = helper_unblock_process(pseudo_clock_sem);
-	/*unblock all pcb blocked on the Pseudo-clock*/
-	while(unblocked_pcb != NULL) {
-		insertProcQ(&readyQ, unblocked_pcb);
-		unblocked_pcb = helper_unblock_process(pseudo_clock_sem);
-	}
-	/* reset pseudo-clock semaphore to 0*/
-	*(pseudo_clock_sem) = 0;
-	if(currentP == NULL) {
-		scheduler();
+	cpu_t now;
+	STCK(now);
+	if(clockArmed && now >= nextClockTick) {
+		int *pseudo_clock_sem = &(device_sem[pseudo_clock_idx]);
+		pcb_PTR unblocked_pcb = helper_unblock_process(pseudo_clock_sem);
+		/*unblock all pcb blocked on the Pseudo-clock*/
+		while(unblocked_pcb != NULL) {
+			insert_readyQ(unblocked_pcb);
+			unblocked_pcb = helper_unblock_process(pseudo_clock_sem);
+		}
+		/* reset pseudo-clock semaphore to 0*/
+		*(pseudo_clock_sem) = 0;
+		/* periodic anti-starvation boost of the ready queue levels*/
+		boost_clock_tick();
+		while(nextClockTick <= now) {
+			nextClockTick += CLOCKINTERVAL;
+		}
 	}
-	/* return control to the current process*/
-	LDST((state_t *)BIOSDATAPAGE);
+	helper_wheel_advance(now);
+	while(timerQ != NULL && timerQ->p_wakeTime <= now) {
+		pcb_PTR woken = timerQ;
+		timerQ = woken->p_timerNext;
+		woken->p_timerNext = NULL;
+		softBlock_count--;
+		insert_readyQ(woken);
+	}
+	/* loading the timer also acknowledges the interrupt */
+	helper_load_interval_timer();
 }
 
 /**********************************************************
  *  non_timer_interrupts()
  *
- *  Identifies the device that caused the interrupt and
- *  processes it accordingly. Checks in Interrupting Devices
- *  Bit Map of that line to see if the device has interrupt.
+ *  Identifies every device of the line with an interrupt
+ *  pending and processes each of them. Checks in Interrupting
+ *  Devices Bit Map of that line to see if the device has interrupt.
  *
  *  Parameters:
  *          int intLineNo - Line Number
@@ -367,9 +749,6 @@ HIDDEN void non_timer_interrupts(int intLineNo) {
 	/* Boolean to later store whether the device has interrupt*/
 	int devIntBool;
 
-	/* address of register of device with interrupt pending*/
-	device_t *intDevRegAdd;
-
 	/* looping through every bit 0-7 to see if the device has interrupt*/
 	int devNo;
 	for(devNo = 0; devNo < DEVPERINT; devNo++) {
@@ -377,14 +756,10 @@ HIDDEN void non_timer_interrupts(int intLineNo) {
 		devIntBool = helper_check_interrupt_device(devNo, intLineDevBitMap);
 
 		if(devIntBool == TRUE) {
-			/* address of register of device*/
-			intDevRegAdd = devAddrBase(intLineNo, devNo);
-
-			if(intLineNo != 7) {
+			if(intLineNo != TERMINT) {
 				helper_non_terminal_device(intLineNo, devNo);
 			} else {
-				int termRead = (((intDevRegAdd->d_status) & 0x000000FF) == 5);
-				helper_terminal_device(intLineNo, devNo, termRead);
+				helper_terminal_device(intLineNo, devNo);
 			}
 		}
 	}
@@ -393,9 +768,12 @@ HIDDEN void non_timer_interrupts(int intLineNo) {
 /**********************************************************
  *  interrupt_exception_handler()
  *
- *  Determines the pending interrupt line and delegates to
- *  the appropriate handler such as process local timer,
- *  pseudo-clock, and devices interrupt handler.
+ *  Services every pending interrupt line in priority order,
+ *  and every pending device of each line, delegating to the
+ *  appropriate handler such as process local timer,
+ *  pseudo-clock, and devices interrupt handler. Then makes a
+ *  single decision: return to the Current Process, or call the
+ *  scheduler if there is none.
  *
  *  Parameters:
  *
@@ -405,6 +783,7 @@ HIDDEN void non_timer_interrupts(int intLineNo) {
 void interrupt_exception_handler() {
 	int lineNum;
 	int lineIntBool;
+	servicedThisEntry = 0;
 	/* loop through the interrupt line for devices*/
 	for(lineNum = 0; lineNum < INTLINESCOUNT; lineNum++) {
 		lineIntBool = helper_check_interrupt_line(lineNum);
@@ -418,14 +797,17 @@ void interrupt_exception_handler() {
 		if(lineIntBool == TRUE) {
 			switch(lineNum) {
 				case INTERPROCESSORINT:
-					/*processor interrupt -- pandos is only for uniprocessor -- this case will not happen -- can safely ignore -- delete later*/
+					/*inter-processor interrupt, only sent when NCPU > 1*/
+					inter_processor_interrupts();
 					break;
 				case PLTINT:
 					/*processor local timer (PLT) interrupt*/
 					process_local_timer_interrupts();
+					break;
 				case INTERVALTIMERINT:
 					/*interval timer interrupt*/
 					pseudo_clock_interrupts();
+					break;
 				case DISKINT:
 				case FLASHINT:
 				case NETWINT:
@@ -433,14 +815,18 @@ void interrupt_exception_handler() {
 				case TERMINT:
 					/*device interrupt*/
 					non_timer_interrupts(lineNum);
+					break;
 				default:
 					break;
 			}
 		}
 	}
+	/* the time spent here is the interrupt bucket of the process that was running*/
+	account_time(CPUTIME_INTERRUPT);
+	/* one return or scheduling decision for everything serviced above*/
 	if(currentP == NULL) {
 		scheduler();
 	}
 	/* return control to the current process*/
-	LDST((state_t *)BIOSDATAPAGE);
+	nucleus_LDST(CPU_EXCSTATE);
 }
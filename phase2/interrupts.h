@@ -12,10 +12,22 @@
 
 extern int process_count;                                     /* Number of started processes */
 extern int softBlock_count;                                   /* Number of started that are in blocked */
-extern pcb_PTR readyQ;                                        /* Tail ptr to a queue of pcbs that are ready */
-extern pcb_PTR currentP;                                      /* Current Process */
+extern percpu_t percpu[NCPU];                                 /* Ready queues and Current Process of each processor */
+#define currentP (percpu[CPUID()].pc_currentP)               /* Current Process of the calling processor */
+#define currentQuantum (percpu[CPUID()].pc_quantum)          /* PLT quantum the Current Process was dispatched with */
 extern int device_sem[DEVINTNUM * DEVPERINT + DEVPERINT + 1]; /* Device Semaphores 49 semaphores in an array */
 
+extern int intServiced[8];                                    /* device interrupts handled, per line */
+extern int intCoalesced[8];                                   /* of which were handled without a new entry */
+extern int clockTicksSkipped;                                 /* pseudo-clock ticks suppressed while idle */
+extern volatile unsigned int tlbFlushGen[NCPU];               /* IPI_TLBFLUSH served by each processor */
+
 void interrupt_exception_handler();
+void init_interrupt_counters();
+void init_interval_timer();
+void clock_idle();
+void clock_rearm();
+void insert_timerQ(pcb_PTR p);
+pcb_PTR out_timerQ(pcb_PTR p);
 
 #endif
\ No newline at end of file
@@ -1,15 +1,37 @@
 /*********************************SCHEDULER.C*******************************
  *  Scheduler Module
  *
- *  This module manages the scheduling of processes in the system. It manages
- *  scheduling the processes gets a chance to run using a round-robin scheduling
- *  method.
- *  The function scheduler() selects the next process from the ready queue
- *  and gives it control.
+ *  This module manages the scheduling of processes in the system. It
+ *  uses a multi-level feedback queue: there are MLFQ_LEVELS ready queues,
+ *  level 0 having the highest priority and the shortest quantum. The
+ *  quantum doubles at each lower level.
+ *  The function scheduler() selects the head of the highest non-empty
+ *  level and gives it control. A bitmap with one bit per non-empty level
+ *  is kept next to the queues, so the level is found in constant time
+ *  by looking the bitmap up in firstLevel[].
  *
- *  The scheduler uses a queue to manage ready processes. When a process is selected to
- *  run, its state is loaded using `LDST()`, and the processor timer is set to 5
- *  milliseconds to ensure proper execution.
+ *  A process that uses its whole quantum (PLT interrupt) is demoted one
+ *  level, a process that blocks on WAITIO is promoted one level, and every
+ *  MLFQ_BOOST_TICKS pseudo-clock ticks every ready process is moved back
+ *  to level 0 so CPU bound processes at the lowest level do not starve.
+ *
+ *  When a process is selected to run, its state is loaded using `LDST()`,
+ *  and the processor timer is set to the quantum of its level.
+ *
+ *  CPU time is measured on the TOD clock: every processor keeps the TOD
+ *  up to which its Current Process has been charged, and each entry to
+ *  and exit from the nucleus charges the time since then to the user,
+ *  nucleus or interrupt bucket of the process (account_time()).
+ *
+ *  With NCPU > 1 every processor has its own set of ready queues in
+ *  percpu[]. A process goes back on the queues of the processor it last
+ *  ran on, new processes on the queues of the processor creating them.
+ *  A processor whose queues are empty steals the highest priority ready
+ *  process of another processor before going idle, and an idle processor
+ *  sitting in WAIT() is woken with an IPI when work is queued for it.
+ *  The nucleus data (ASL, pcb pool, ready queues, device semaphores) is
+ *  protected by one nucleus lock, taken on entry to exception_handler()
+ *  and released by nucleus_LDST() or before the processor idles.
  *
  *  Modified by Phuong and Oghap on Feb 2025
  */
@@ -24,18 +46,392 @@
 #include "initial.h"
 
 #include "scheduler.h"
+#include "interrupts.h"
+
+#define NOLEVEL -1
+
+HIDDEN int firstLevel[1 << MLFQ_LEVELS];      /* highest priority level set in a bitmap */
+HIDDEN int boostTicks;                        /* pseudo-clock ticks since the last boost */
+#if NCPU > 1
+HIDDEN volatile unsigned int nucleusLock = 0; /* held by the processor running nucleus code */
+#endif
+
+/**********************************************************
+ *  acquire_nucleus_lock()
+ *
+ *  Spins until the calling processor owns the nucleus lock.
+ *  Does nothing on a uniprocessor.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void acquire_nucleus_lock() {
+#if NCPU > 1
+	while(!CAS((unsigned int *)&nucleusLock, 0, 1)) {
+		;
+	}
+#endif
+}
+
+/**********************************************************
+ *  release_nucleus_lock()
+ *
+ *  Gives up the nucleus lock held by the calling processor.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void release_nucleus_lock() {
+#if NCPU > 1
+	nucleusLock = 0;
+#endif
+}
+
+/**********************************************************
+ *  nucleus_LDST()
+ *
+ *  Leaves the nucleus: releases the nucleus lock and loads
+ *  the given processor state. Every exit of the nucleus to
+ *  a process goes through here.
+ *
+ *  Parameters:
+ *         state_PTR s - processor state to load
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void nucleus_LDST(state_PTR s) {
+	release_nucleus_lock();
+	LDST(s);
+}
+
+/**********************************************************
+ *  account_time()
+ *
+ *  Charges the TOD time elapsed since the last accounting
+ *  point of the calling processor to one bucket of its
+ *  Current Process, and starts the next interval now. With no
+ *  Current Process the time belongs to nobody and is dropped.
+ *
+ *  Parameters:
+ *         int bucket - CPUTIME_USER, CPUTIME_NUCLEUS or
+ *                      CPUTIME_INTERRUPT
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void account_time(int bucket) {
+	cpu_t now;
+	percpu_t *cpu = &percpu[CPUID()];
+	STCK(now);
+	if(cpu->pc_currentP != NULL) {
+		cpu->pc_currentP->p_time[bucket] += now - cpu->pc_mark;
+	}
+	cpu->pc_mark = now;
+}
+
+/**********************************************************
+ *  send_ipi()
+ *
+ *  Sends an inter-processor interrupt carrying msg to every
+ *  processor in the mask.
+ *
+ *  Parameters:
+ *         int cpuMask - bit i set to send to processor i
+ *         int msg - IPI_WAKEUP or IPI_TLBFLUSH
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void send_ipi(int cpuMask, int msg) {
+	if(cpuMask != 0) {
+		*((memaddr *)IPI_OUTBOX) = (cpuMask << IPI_RECIPIENT_SHIFT) | msg;
+	}
+}
+
+/**********************************************************
+ *  wake_idle_cpu()
+ *
+ *  Called after a process was put on the ready queues of cpu.
+ *  Wakes cpu if it is idle; otherwise wakes some other idle
+ *  processor, which will steal the work.
+ *
+ *  Parameters:
+ *         int cpu - processor the process was queued on
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void wake_idle_cpu(int cpu) {
+	int i;
+	if(cpu != CPUID() && percpu[cpu].pc_idle) {
+		send_ipi(1 << cpu, IPI_WAKEUP);
+		return;
+	}
+	for(i = 0; i < NCPU; i++) {
+		if(i != CPUID() && percpu[i].pc_idle) {
+			send_ipi(1 << i, IPI_WAKEUP);
+			return;
+		}
+	}
+}
+
+/**********************************************************
+ *  init_readyQ()
+ *
+ *  Empties every ready queue level of every processor and fills the lookup table
+ *  giving the highest priority level present in a bitmap.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void init_readyQ() {
+	int i;
+	int level;
+	int cpu;
+	for(cpu = 0; cpu < NCPU; cpu++) {
+		for(level = 0; level < MLFQ_LEVELS; level++) {
+			percpu[cpu].pc_readyQ[level] = mkEmptyProcQ();
+		}
+		percpu[cpu].pc_readyBitmap = 0;
+	}
+	boostTicks = 0;
+
+	/* the lowest bit set is the highest priority level */
+	firstLevel[0] = NOLEVEL;
+	for(i = 1; i < (1 << MLFQ_LEVELS); i++) {
+		level = 0;
+		while(((i >> level) & 1) == 0) {
+			level++;
+		}
+		firstLevel[i] = level;
+	}
+}
+
+/**********************************************************
+ *  insert_readyQ()
+ *
+ *  Inserts a process at the tail of the ready queue of its level,
+ *  on the processor it last ran on, or on the calling processor
+ *  for a process that never ran.
+ *
+ *  Parameters:
+ *         pcb_PTR p - process to insert
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void insert_readyQ(pcb_PTR p) {
+	if(p->p_cpu == NOCPU) {
+		p->p_cpu = CPUID();
+	}
+	percpu_t *cpu = &(percpu[p->p_cpu]);
+	insertProcQ(&(cpu->pc_readyQ[p->p_prio]), p);
+	cpu->pc_readyBitmap |= (1 << p->p_prio);
+#if NCPU > 1
+	wake_idle_cpu(p->p_cpu);
+#endif
+}
+
+/**********************************************************
+ *  out_readyQ()
+ *
+ *  Removes a process from the ready queue of its level, if it
+ *  is on it.
+ *
+ *  Parameters:
+ *         pcb_PTR p - process to remove
+ *
+ *  Returns:
+ *         pcb_PTR - p, or NULL if p was not ready
+ **********************************************************/
+pcb_PTR out_readyQ(pcb_PTR p) {
+	if(p->p_cpu == NOCPU) {
+		return NULL;
+	}
+	percpu_t *cpu = &(percpu[p->p_cpu]);
+	pcb_PTR removed = outProcQ(&(cpu->pc_readyQ[p->p_prio]), p);
+	if(emptyProcQ(cpu->pc_readyQ[p->p_prio])) {
+		cpu->pc_readyBitmap &= ~(1 << p->p_prio);
+	}
+	return removed;
+}
+
+/**********************************************************
+ *  remove_readyQ()
+ *
+ *  Removes the head of the highest priority non-empty level
+ *  of the ready queues of a processor.
+ *
+ *  Parameters:
+ *         percpu_t *cpu - processor whose ready queues are used
+ *
+ *  Returns:
+ *         pcb_PTR - the removed process, or NULL if no process is ready
+ **********************************************************/
+HIDDEN pcb_PTR remove_readyQ(percpu_t *cpu) {
+	int level = firstLevel[cpu->pc_readyBitmap];
+	if(level == NOLEVEL) {
+		return NULL;
+	}
+	pcb_PTR p = removeProcQ(&(cpu->pc_readyQ[level]));
+	if(emptyProcQ(cpu->pc_readyQ[level])) {
+		cpu->pc_readyBitmap &= ~(1 << level);
+	}
+	return p;
+}
+
+/**********************************************************
+ *  next_process()
+ *
+ *  Picks the next process for the calling processor: the
+ *  head of its own ready queues, or else the highest priority
+ *  ready process stolen from another processor.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *         pcb_PTR - the process to run, or NULL if no process is ready
+ **********************************************************/
+HIDDEN pcb_PTR next_process() {
+	pcb_PTR p = remove_readyQ(&(percpu[CPUID()]));
+#if NCPU > 1
+	int i;
+	int victim = NOCPU;
+	int bestLevel = MLFQ_LEVELS;
+	if(p != NULL) {
+		return p;
+	}
+	for(i = 0; i < NCPU; i++) {
+		int level = firstLevel[percpu[i].pc_readyBitmap];
+		if(i != CPUID() && level != NOLEVEL && level < bestLevel) {
+			bestLevel = level;
+			victim = i;
+		}
+	}
+	if(victim != NOCPU) {
+		p = remove_readyQ(&(percpu[victim]));
+	}
+#endif
+	return p;
+}
+
+/**********************************************************
+ *  cpu_running()
+ *
+ *  Tells whether a processor other than the calling one is
+ *  running a process, which may still unblock or create work.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *         TRUE or FALSE
+ **********************************************************/
+HIDDEN int cpu_running() {
+	int i;
+	for(i = 0; i < NCPU; i++) {
+		if(i != CPUID() && percpu[i].pc_currentP != NULL) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/**********************************************************
+ *  demote_process()
+ *
+ *  Moves a process that used its whole quantum one level down.
+ *  The process must not be on a ready queue.
+ *
+ *  Parameters:
+ *         pcb_PTR p - process to demote
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void demote_process(pcb_PTR p) {
+	if(p->p_prio < MLFQ_LEVELS - 1) {
+		p->p_prio++;
+	}
+}
+
+/**********************************************************
+ *  promote_process()
+ *
+ *  Moves a process that blocked for I/O one level up.
+ *  The process must not be on a ready queue.
+ *
+ *  Parameters:
+ *         pcb_PTR p - process to promote
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void promote_process(pcb_PTR p) {
+	if(p->p_prio > 0) {
+		p->p_prio--;
+	}
+}
+
+/**********************************************************
+ *  boost_clock_tick()
+ *
+ *  Called on every pseudo-clock tick. Every MLFQ_BOOST_TICKS
+ *  ticks, moves every ready process, and the Current Process
+ *  of every processor, back to level 0.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void boost_clock_tick() {
+	int level;
+	int cpu;
+	pcb_PTR p;
+
+	boostTicks++;
+	if(boostTicks < MLFQ_BOOST_TICKS) {
+		return;
+	}
+	boostTicks = 0;
+
+	for(cpu = 0; cpu < NCPU; cpu++) {
+		for(level = 1; level < MLFQ_LEVELS; level++) {
+			p = removeProcQ(&(percpu[cpu].pc_readyQ[level]));
+			while(p != NULL) {
+				p->p_prio = 0;
+				insert_readyQ(p);
+				p = removeProcQ(&(percpu[cpu].pc_readyQ[level]));
+			}
+			percpu[cpu].pc_readyBitmap &= ~(1 << level);
+		}
+		if(percpu[cpu].pc_currentP != NULL) {
+			percpu[cpu].pc_currentP->p_prio = 0;
+		}
+	}
+}
 
 /**********************************************************
  *  scheduler()
  *
- *  This function determines the next process from the ready queue
+ *  This function determines the next process from the ready queues
  *  and schedules it for execution. If no process is ready, it
  *  determines the appropriate system action based on the process
  *  count and soft-block count.
  *
- *  The scheduler implements a round-robin scheduling method and
- *  sets each process to get an execution time by setting
- *  the processor timer to 5 milliseconds.
+ *  The process is given the quantum of its level by setting
+ *  the processor timer.
+ *
+ *  Called with the nucleus lock held. A processor with nothing
+ *  to run while other processors still run processes idles
+ *  instead of declaring a deadlock.
  *
  *  Parameters:
  *
@@ -44,14 +440,18 @@
  *
  **********************************************************/
 void scheduler() {
-	currentP = removeProcQ(&readyQ); /* if the ready Q is empty */
+	currentP = next_process(); /* if the ready Q is empty */
 	if(currentP == NULL) {
 		/* if the Process Count is zero */
 		if(process_count == 0) {
 			HALT();
 
-		} else if(softBlock_count > 0) {
-			/* if Process Count > 0 and the Soft-block Count > 0 */
+		} else if(softBlock_count > 0 || cpu_running()) {
+			/* if Process Count > 0 and the Soft-block Count > 0, or another processor may still create work */
+			percpu[CPUID()].pc_idle = TRUE;
+			/* tickless idle: no pseudo-clock interrupt unless somebody needs it */
+			clock_idle();
+			release_nucleus_lock();
 
 			/* get status, enable interrupt on current enable bit, disable PLT, enable Interrupt Mask */
 			setSTATUS(0x0000ff01);
@@ -62,9 +462,36 @@ void scheduler() {
 		}
 	}
 
-	/*Load 5 milisec on the PLT*/
-	setTIMER(5000);
+	/* the process now belongs to this processor, it is queued here when it becomes ready again */
+	percpu[CPUID()].pc_idle = FALSE;
+	/* processes left waiting for this one may need the anti-starvation boost */
+	if(percpu[CPUID()].pc_readyBitmap != 0) {
+		clock_rearm();
+	}
+	currentP->p_cpu = CPUID();
+
+	/* Load the quantum of the process level on the PLT */
+	currentQuantum = MLFQ_BASE_QUANTUM << currentP->p_prio;
+	setTIMER(currentQuantum);
+	/* the process is charged from now on */
+	STCK(percpu[CPUID()].pc_mark);
 
 	/* pass in the address of current process processor state */
-	LDST(&(currentP->p_s));
-}
\ No newline at end of file
+	nucleus_LDST(&(currentP->p_s));
+}
+
+/**********************************************************
+ *  cpu_start()
+ *
+ *  First code run by the processors other than processor 0,
+ *  started by main() with INITCPU(). Enters the scheduler.
+ *
+ *  Parameters:
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void cpu_start() {
+	acquire_nucleus_lock();
+	scheduler();
+}
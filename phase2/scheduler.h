@@ -12,10 +12,23 @@
 
 extern int process_count;                                     /* Number of started processes */
 extern int softBlock_count;                                   /* Number of started that are in blocked */
-extern pcb_PTR readyQ;                                        /* Tail ptr to a queue of pcbs that are ready */
-extern pcb_PTR currentP;                                      /* Current Process */
+extern percpu_t percpu[NCPU];                                 /* Ready queues and Current Process of each processor */
+#define currentP (percpu[CPUID()].pc_currentP)               /* Current Process of the calling processor */
+#define currentQuantum (percpu[CPUID()].pc_quantum)          /* PLT quantum the Current Process was dispatched with */
 extern int device_sem[DEVINTNUM * DEVPERINT + DEVPERINT + 1]; /* Device Semaphores 49 semaphores in an array */
 
 void scheduler();
+void init_readyQ();
+void insert_readyQ(pcb_PTR p);
+pcb_PTR out_readyQ(pcb_PTR p);
+void demote_process(pcb_PTR p);
+void promote_process(pcb_PTR p);
+void boost_clock_tick();
+void acquire_nucleus_lock();
+void release_nucleus_lock();
+void nucleus_LDST(state_PTR s);
+void account_time(int bucket);
+void send_ipi(int cpuMask, int msg);
+void cpu_start();
 
 #endif
\ No newline at end of file
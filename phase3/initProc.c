@@ -22,9 +22,15 @@
 #include "vmSupport.h"
 #include "sysSupport.h"
 #include "../phase5/delayDaemon.h"
+#include "../phase4/devSupport.h"
+#include "../phase2/interrupts.h"
 
 int masterSemaphore = 0;
 int mutex[DEVINTNUM * DEVPERINT + DEVPERINT];
+HIDDEN cpu_t runStart; /* TOD when test() started, in microseconds */
+HIDDEN int setupFull[UPROC_NUM];  /* filled slots of the set up ring of each flash */
+HIDDEN int setupEmpty[UPROC_NUM]; /* empty slots of the set up ring of each flash */
+HIDDEN int setupFailed[UPROC_NUM]; /* TRUE once a read of the flash failed during the set up */
 
 void debugSBS(){
 
@@ -34,8 +40,8 @@ void debugSBS(){
  *  init_Uproc_pgTable
  *
  *  Initializes the page table for a user-level process.
- *  Sets EntryHi with VPN and ASID, and EntryLo with initial
- *  D, V, and G bit settings. Stack page is set separately.
+ *  Sets EntryHi with VPN and ASID, and EntryLo with every
+ *  page not valid and clean. Stack page is set separately.
  *
  *  Parameters:
  *         support_t *currentSupport – pointer to U-proc's support structure
@@ -49,7 +55,8 @@ void init_Uproc_pgTable(support_t *currentSupport) {
 	for(i = 0; i < PAGE_TABLE_SIZE; i++) {
 		/* ASID field, for any given Page Table, will all be set to the U-proc’s unique ID*/
 		currentSupport->sup_privatePgTbl[i].EntryHi = KUSEG + (i * PAGESIZE) + (currentSupport->sup_asid << ASID_SHIFT);
-		currentSupport->sup_privatePgTbl[i].EntryLo = (DBITON & GBITOFF) & VBITOFF;
+		/* not valid, and clean: write permission (D bit) is only given on the first write */
+		currentSupport->sup_privatePgTbl[i].EntryLo = ALLOFF;
 	}
 	/* reset the idx 31 element */
 	currentSupport->sup_privatePgTbl[PAGE_TABLE_SIZE - 1].EntryHi = UPROC_STACK_AREA + (currentSupport->sup_asid << ASID_SHIFT);
@@ -90,8 +97,6 @@ int init_Uproc(support_t *initSupportPTR, int ASID) {
 	initSupportPTR->sup_exceptContext[PGFAULTEXCEPT].c_stackPtr = &initSupportPTR->sup_stackTlb[TLB_STACK_AREA];
 	initSupportPTR->sup_exceptContext[GENERALEXCEPT].c_stackPtr = &initSupportPTR->sup_stackGen[GEN_EXC_STACK_AREA];
 
-	initSupportPTR->delaySem = 0;
-
 	init_Uproc_pgTable(initSupportPTR);
 
 	int newPcbStat = SYSCALL(1, &initState, initSupportPTR, 0);
@@ -118,9 +123,21 @@ void helper_copy_block(int *src, int *dst){
     }
 }
 
-int helper_read_flash(int devNo, int blockNo){
-    int flash_sem_idx = devSemIdx(FLASHINT, devNo, FALSE);
-
+/**********************************************************
+ *  helper_read_flash
+ *
+ *  Reads one block of a flash device into a RAM frame.
+ *  The caller holds the mutex of the flash device.
+ *
+ *  Parameters:
+ *         int devNo – flash device number
+ *         int blockNo – block to read
+ *         memaddr dst – frame the block is read into
+ *
+ *  Returns:
+ *         int – READY, or the negated device status on error
+ **********************************************************/
+int helper_read_flash(int devNo, int blockNo, memaddr dst){
     device_t *flash_dev_reg_addr = devAddrBase(FLASHINT, devNo);
 
 	/*delete this condition out after finishing -- this should never be called*/
@@ -128,7 +145,7 @@ int helper_read_flash(int devNo, int blockNo){
         SYSCALL(TERMINATETHREAD, 0, 0, 0);
     }
     
-    flash_dev_reg_addr->d_data0 = FLASK_DMA_BUFFER_BASE_ADDR + (BLOCKSIZE*devNo);
+    flash_dev_reg_addr->d_data0 = dst;
     setSTATUS(getSTATUS() & (~IECBITON));
     	flash_dev_reg_addr->d_command = (blockNo << BLOCKNUM_SHIFT) + READBLK_FLASH;
         int flash_status = SYSCALL(IOWAIT, FLASHINT, devNo, 0);
@@ -141,33 +158,41 @@ int helper_read_flash(int devNo, int blockNo){
     }
 }
 
-int helper_write_disk(int secNo2D){
+/**********************************************************
+ *  helper_write_disk
+ *
+ *  Writes one frame to a sector of the swap disk. The caller
+ *  holds the mutex of the swap disk and keeps it on error.
+ *
+ *  Parameters:
+ *         int secNo2D – linear sector number
+ *         memaddr src – frame written
+ *
+ *  Returns:
+ *         int – READY, or the negated device status on error
+ **********************************************************/
+int helper_write_disk(int secNo2D, memaddr src){
     int devNo = RESERVED_DISK_NO;
-    int disk_sem_idx = devSemIdx(DISKINT, devNo, FALSE);
 
     device_t *disk_dev_reg_addr = devAddrBase(DISKINT, devNo);
 
-    int maxcyl = ((disk_dev_reg_addr->d_data1) >> 16) & 0xFFFF;
-    int maxhead = ((disk_dev_reg_addr->d_data1) >> 8) & 0xFF;
-    int maxsect = (disk_dev_reg_addr->d_data1) & 0xFF;
+    int maxcyl = diskState[devNo].dk_maxcyl;
+    int maxhead = diskState[devNo].dk_maxhead;
+    int maxsect = diskState[devNo].dk_maxsect;
 
 	/*delete this out after finishing -- should never happen*/
-    if (secNo2D > (maxcyl*maxhead*maxsect)){
+    if (secNo2D >= (maxcyl*maxhead*maxsect)){
         SYSCALL(TERMINATETHREAD, 0, 0, 0);
     }
 
     int sectNo = (secNo2D % (maxhead * maxsect)) % maxsect;
 	int headNo = (secNo2D % (maxhead * maxsect)) / maxsect; /*divide and round down*/
     int cylNo = secNo2D / (maxhead * maxsect);
-    setSTATUS(getSTATUS() & (~IECBITON));
-        disk_dev_reg_addr->d_command = (cylNo << CYLNUM_SHIFT) + SEEKCYL; /*seek*/
-        int disk_status = SYSCALL(IOWAIT, DISKINT, devNo, 0);
-    setSTATUS(getSTATUS() | IECBITON);
+    int disk_status = disk_seek(devNo, cylNo);
     if (disk_status != READY){
-        SYSCALL(VERHO, &(mutex[disk_sem_idx]), 0, 0);
         return 0 - disk_status;
     }
-    disk_dev_reg_addr->d_data0 = DISK_DMA_BUFFER_BASE_ADDR + (BLOCKSIZE*devNo); /*carefull not to do anything with device between writing to data0 and command*/
+    disk_dev_reg_addr->d_data0 = src; /*carefull not to do anything with device between writing to data0 and command*/
     setSTATUS(getSTATUS() & (~IECBITON));
         disk_dev_reg_addr->d_command = (headNo << HEADNUM_SHIFT) + (sectNo << SECTNUM_SHIFT) + WRITEBLK_DSK; /*write*/
         disk_status = SYSCALL(IOWAIT, DISKINT, devNo, 0);
@@ -180,34 +205,239 @@ int helper_write_disk(int secNo2D){
     }
 }
 
+/**********************************************************
+ *  helper_setup_slot
+ *
+ *  Gives the bounce frame holding a page of a flash during the
+ *  set up of the backing store. Each flash owns a ring of
+ *  SETUP_RING frames taken from the swap pool, which is not in
+ *  use before the U-procs start.
+ *
+ *  Parameters:
+ *         int devNo – flash device number
+ *         int pageNo – page of the flash
+ *
+ *  Returns:
+ *         memaddr – address of the bounce frame
+ **********************************************************/
+HIDDEN memaddr helper_setup_slot(int devNo, int pageNo){
+	return SWAP_POOL_START + (((devNo * SETUP_RING) + (pageNo % SETUP_RING)) * PAGESIZE);
+}
+
+/**********************************************************
+ *  setup_flash_reader
+ *
+ *  Body of the kernel-mode process reading one flash during the
+ *  set up of the backing store. It reads the pages in order into
+ *  the ring of the flash, as long as the ring has an empty slot,
+ *  then terminates. A failed read is recorded in setupFailed.
+ *
+ *  Parameters:
+ *         int devNo – flash device number, passed in a0
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void setup_flash_reader(int devNo){
+	int pageNo;
+	int flash_sem_idx = devSemIdx(FLASHINT, devNo, FALSE);
+
+	for (pageNo = 0; pageNo < PAGE_TABLE_SIZE; pageNo++){
+		SYSCALL(PASSERN, &(setupEmpty[devNo]), 0, 0);
+		SYSCALL(PASSERN, &(mutex[flash_sem_idx]), 0, 0);
+			if (helper_read_flash(devNo, pageNo, helper_setup_slot(devNo, pageNo)) != READY){
+				setupFailed[devNo] = TRUE;
+			}
+		SYSCALL(VERHO, &(mutex[flash_sem_idx]), 0, 0);
+		SYSCALL(VERHO, &(setupFull[devNo]), 0, 0);
+	}
+	SYSCALL(TERMINATETHREAD, 0, 0, 0);
+}
+
+/**********************************************************
+ *  set_up_backing_store
+ *
+ *  Copies the flash of every U-proc to its blocks of the swap
+ *  disk. One reader process per installed flash keeps reads in
+ *  flight on all of them at once, each into its own ring of
+ *  bounce frames. The disk is written straight from the rings
+ *  in ascending block order, which is cylinder, then head, then
+ *  sector order, so the arm sweeps the disk once and disk_seek
+ *  only moves it when the cylinder changes. A U-proc whose
+ *  flash or disk blocks failed is not marked copied, so its
+ *  pages keep coming from its flash as in the lazy set up.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
 void set_up_backing_store(){
 	int devNo;
 	int pageNo;
-
-	int flash_sem_idx;
+	int copied;
 	int disk_sem_idx = devSemIdx(DISKINT, RESERVED_DISK_NO, FALSE);
+	int installed = ((devregarea_t *)RAMBASEADDR)->inst_dev[FLASHINT - DISKINT];
+	state_t readerState;
 
-	int flash_status;
-	int disk_status;
-	
+	for (devNo = 0; devNo < UPROC_NUM; devNo++){
+		setupFull[devNo] = 0;
+		setupEmpty[devNo] = SETUP_RING;
+		setupFailed[devNo] = FALSE;
+		if ((installed & (1 << devNo)) == 0){
+			continue;
+		}
+		readerState.s_pc = (memaddr)setup_flash_reader;
+		readerState.s_t9 = (memaddr)setup_flash_reader;
+		readerState.s_a0 = devNo;
+		/* below the stacks of test and the page cleaner */
+		readerState.s_sp = ((devregarea_t *)RAMBASEADDR)->rambase + ((devregarea_t *)RAMBASEADDR)->ramsize - ((SETUP_STACK_FRAME + devNo) * PAGESIZE);
+		readerState.s_status = (IEPBITON & KUPBITOFF) | IPBITS;
+		readerState.s_entryHI = 0 << ASID_SHIFT;
+		SYSCALL(CREATETHREAD, &readerState, NULL, 0);
+	}
 
 	SYSCALL(PASSERN, &(mutex[disk_sem_idx]), 0, 0);
 	for (devNo = 0; devNo < UPROC_NUM; devNo++){
+		if ((installed & (1 << devNo)) == 0){
+			continue;
+		}
+		copied = TRUE;
 		for (pageNo = 0; pageNo < PAGE_TABLE_SIZE; pageNo++){
-			flash_sem_idx = devSemIdx(FLASHINT, devNo, FALSE);
+			SYSCALL(PASSERN, &(setupFull[devNo]), 0, 0);
+				/* a slot whose read failed holds no page, it is not written */
+				if (setupFailed[devNo] || helper_write_disk(PAGE_TABLE_SIZE*devNo + pageNo, helper_setup_slot(devNo, pageNo)) != READY){
+					copied = FALSE;
+				}
+			SYSCALL(VERHO, &(setupEmpty[devNo]), 0, 0);
+		}
+		if (copied){
+			mark_backing_store_copied(devNo + 1);
+		}
+	}
+	SYSCALL(VERHO, &(mutex[disk_sem_idx]), 0, 0);
+}
 
-			SYSCALL(PASSERN, &(mutex[flash_sem_idx]), 0, 0);
+/**********************************************************
+ *  helper_report_line
+ *
+ *  Writes a line "<label><value>" on terminal 0, one character
+ *  at a time, blocking on SYS5 after each one. Used for the
+ *  report printed at the end of the run.
+ *
+ *  Parameters:
+ *         char *label – text written before the value
+ *         int value – value written in decimal
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void helper_report_line(char *label, int value) {
+	char line[REPORT_LINE_MAX];
+	char digits[REPORT_LINE_MAX];
+	int len = 0;
+	int nDigits = 0;
+	int i;
 
-				flash_status = helper_read_flash(devNo, pageNo);
-				
-				helper_copy_block(FLASK_DMA_BUFFER_BASE_ADDR + (BLOCKSIZE*devNo), DISK_DMA_BUFFER_BASE_ADDR + (BLOCKSIZE*devNo));
-				
-				disk_status = helper_write_disk(32*devNo + pageNo);
+	while(*label != EOS && len < REPORT_LINE_MAX - REPORT_VALUE_MAX) {
+		line[len++] = *label;
+		label++;
+	}
+	if(value < 0) {
+		line[len++] = '-';
+		value = -value;
+	}
+	/* digits come out least significant first */
+	do {
+		digits[nDigits++] = '0' + (value % 10);
+		value = value / 10;
+	} while(value > 0);
+	while(nDigits > 0) {
+		line[len++] = digits[--nDigits];
+	}
+	line[len++] = NEW_LINE;
+
+	device_t *termDevAdd = devAddrBase(TERMINT, 0);
+	int mutexSemIdx = devSemIdx(TERMINT, 0, FALSE);
+	SYSCALL(PASSERN, &(mutex[mutexSemIdx]), 0, 0);
+	for(i = 0; i < len; i++) {
+		setSTATUS(getSTATUS() & (~IECBITON));
+		termDevAdd->t_transm_command = (line[i] << TRANS_COMMAND_SHIFT) + TRANSMIT_COMMAND;
+		SYSCALL(IOWAIT, TERMINT, 0, FALSE);
+		setSTATUS(getSTATUS() | IECBITON);
+	}
+	SYSCALL(VERHO, &(mutex[mutexSemIdx]), 0, 0);
+}
+
+/**********************************************************
+ *  print_run_report
+ *
+ *  Prints the support level counters of the run on
+ *  terminal 0, once every U-proc has terminated.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void print_run_report() {
+	int i;
+	cpu_t runEnd;
+	STCK(runEnd);
+	int elapsedMs = (runEnd - runStart) / 1000;
+	if(elapsedMs == 0) {
+		elapsedMs = 1;
+	}
 
-			SYSCALL(VERHO, &(mutex[flash_sem_idx]), 0, 0);
+	helper_report_line("page faults: ", pageFaults);
+	helper_report_line("page evictions: ", pageEvictions);
+	helper_report_line("clock second chances: ", pageSecondChances);
+	helper_report_line("pages dirtied: ", pageDirtied);
+	helper_report_line("write-backs avoided: ", pageWritesAvoided);
+	helper_report_line("pages pre-cleaned: ", pagesCleaned);
+	helper_report_line("page-ins from flash: ", pagesFromFlash);
+	helper_report_line("first user instruction (us): ", firstUserTOD - runStart);
+	int seeks = 0;
+	int seeksSkipped = 0;
+	for(i = 0; i < DEVPERINT; i++) {
+		seeks += diskState[i].dk_seeks;
+		seeksSkipped += diskState[i].dk_seeksSkipped;
+	}
+	helper_report_line("disk seeks issued: ", seeks);
+	helper_report_line("disk seeks skipped: ", seeksSkipped);
+	helper_report_line("block cache hits: ", cacheHits);
+	helper_report_line("block cache misses: ", cacheMisses);
+	helper_report_line("blocks prefetched: ", cachePrefetches);
+	helper_report_line("PUTs completed in cache: ", cacheWritesCached);
+	helper_report_line("cache write-backs: ", cacheWriteBacks);
+	helper_report_line("cache write-back errors: ", cacheWriteErrors);
+	helper_report_line("terminal input dropped: ", termCharsDropped);
+	int wakeups = 0;
+	int latenessTotal = 0;
+	int latenessMax = 0;
+	int refills = 0;
+	for(i = 0; i < NCPU; i++) {
+		wakeups += delayWakeups[i];
+		latenessTotal += delayLatenessTotal[i];
+		if(delayLatenessMax[i] > latenessMax) {
+			latenessMax = delayLatenessMax[i];
 		}
+		refills += tlbRefills[i];
 	}
-	SYSCALL(VERHO, &(mutex[disk_sem_idx]), 0, 0);
+	helper_report_line("DELAY wake-ups: ", wakeups);
+	helper_report_line("DELAY mean lateness (us): ", wakeups == 0 ? 0 : latenessTotal / wakeups);
+	helper_report_line("DELAY max lateness (us): ", latenessMax);
+	helper_report_line("pseudo-clock ticks skipped: ", clockTicksSkipped);
+	cpu_t testTime[CPUTIME_BUCKETS];
+	SYSCALL(CPUTIMESPLIT, testTime, 0, 0);
+	helper_report_line("test user time (us): ", testTime[CPUTIME_USER]);
+	helper_report_line("test nucleus time (us): ", testTime[CPUTIME_NUCLEUS]);
+	helper_report_line("test interrupt time (us): ", testTime[CPUTIME_INTERRUPT]);
+	helper_report_line("TLB refills: ", refills);
+	/* split so refills * 1000 cannot overflow */
+	helper_report_line("TLB refills per second: ", (refills / elapsedMs) * 1000 + ((refills % elapsedMs) * 1000) / elapsedMs);
 }
 
 /**********************************************************
@@ -217,6 +447,7 @@ void set_up_backing_store(){
  *  - Initializes swap structures and mutexes
  *  - Sets 8 user processes with init_Uproc()
  *  - Waits for all user processes to finish
+ *  - Prints the report of the run
  *
  *  Parameters:
  *
@@ -226,13 +457,28 @@ void set_up_backing_store(){
  **********************************************************/
 void test() {
 	int i;
+	STCK(runStart);
 	for(i = 0; i < (DEVINTNUM * DEVPERINT + DEVPERINT); i++) {
 		mutex[i] = 1;
 	}
 	
+	initDiskState();
 	initSwapStruct();
+#if VM_SELFTEST
+	if(!check_pinned_replace()) {
+		PANIC();
+	}
+#endif
+#if EAGER_BACKING_STORE
 	set_up_backing_store();
-	initADL();
+#endif
+	initDiskScheduler();
+	initBlockCache();
+	initPrintSpool();
+	initTermOutput();
+	initTermInput();
+	initDelay();
+	initPageCleaner();
 
 	support_t initSupportPTRArr[UPROC_NUM + 1]; /*1 extra sentinel node*/
 
@@ -248,5 +494,13 @@ void test() {
 		SYSCALL(PASSERN, &masterSemaphore, 0, 0); /* P operation */
 	}
 
+	flushBlockCache();
+	/* the report goes to terminal 0 after what the U-procs queued there */
+	for(i = 0; i < DEVPERINT; i++) {
+		print_flush(i);
+		term_flush(i);
+	}
+	print_run_report();
+
 	SYSCALL(TERMINATETHREAD, 0, 0, 0);
 }
\ No newline at end of file
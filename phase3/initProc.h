@@ -15,7 +15,11 @@
 #include "../h/types.h"
 #include "../h/const.h"
 
+#define REPORT_LINE_MAX 64 /* longest line of the end of run report */
+#define REPORT_VALUE_MAX 12 /* room kept for the sign, the digits and the newline */
+
 void test();
+void helper_report_line(char *label, int value);
 extern int mutex[DEVINTNUM * DEVPERINT + DEVPERINT];
 extern int masterSemaphore;
 
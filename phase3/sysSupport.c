@@ -24,6 +24,11 @@
 #include "../phase4/devSupport.h"
 #include "../phase5/delayDaemon.h"
 
+HIDDEN spool_t printSpool[DEVPERINT]; /* spool of each printer */
+HIDDEN termtx_t termTx[DEVPERINT]; /* transmit ring of each terminal */
+HIDDEN termrx_t termRx[DEVPERINT]; /* input ring of each terminal */
+int termCharsDropped;              /* characters received with the input ring full */
+
 /**********************************************************
  *  helper_check_string_outside_addr_space
  *
@@ -100,10 +105,18 @@ void TERMINATE(support_t *passedUpSupportStruct) {
 	/* mark all of the frames it occupied as unoccupied */
 	SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
 	for(i = 0; i < SWAP_POOL_SIZE; i++) {
-		if(swapPoolTable[i].ASID == passedUpSupportStruct->sup_asid) {
+		/* a frame in transit is finished by the Pager moving it */
+		if(swapPoolTable[i].ASID == passedUpSupportStruct->sup_asid && (swapPoolTable[i].state == FRAME_CLEANING || swapPoolTable[i].state == FRAME_EVICTING)) {
+			/* the page cleaner, or the Pager evicting it, frees it once its write-back ends */
+			swapPoolTable[i].ASID = -1;
+		}
+		if(swapPoolTable[i].ASID == passedUpSupportStruct->sup_asid && swapPoolTable[i].state == FRAME_INUSE) {
+			swapPoolTable[i].state = FRAME_FREE;
 			swapPoolTable[i].ASID = -1;
 			swapPoolTable[i].VPN = -1;
 			swapPoolTable[i].matchingPgTableEntry = NULL;
+			swapPoolTable[i].referenced = FALSE;
+			swapPoolTable[i].pinned = 0;
 		}
 	}
 	SYSCALL(VERHO, &swapPoolSema4, 0, 0);
@@ -138,11 +151,152 @@ void GET_TOD(support_t *passedUpSupportStruct) {
 	STCK(passedUpSupportStruct->sup_exceptState[GENERALEXCEPT].s_v0);
 }
 
+/**********************************************************
+ *  printer_spooler
+ *
+ *  Body of the kernel-mode process printing the jobs spooled
+ *  on one printer, in FIFO order, one PRINTCHR and SYS5 wait
+ *  per character under the printer mutex. A job leaves the
+ *  spool once its last character is printed.
+ *
+ *  Parameters:
+ *         int devNo – printer drained
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void printer_spooler(int devNo) {
+	spool_t *sp = &(printSpool[devNo]);
+	device_t *printerDevAdd = devAddrBase(PRNTINT, devNo);
+	int mutexSemIdx = devSemIdx(PRNTINT, devNo, FALSE);
+	int devStatus;
+	char c;
+
+	while(TRUE) {
+		SYSCALL(PASSERN, &(sp->sp_lock), 0, 0);
+		if(sp->sp_count == 0) {
+			while(sp->sp_flushWaiters > 0) {
+				sp->sp_flushWaiters--;
+				SYSCALL(VERHO, &(sp->sp_drained), 0, 0);
+			}
+			sp->sp_asleep = TRUE;
+			SYSCALL(VERHO, &(sp->sp_lock), 0, 0);
+			SYSCALL(PASSERN, &(sp->sp_work), 0, 0);
+			continue;
+		}
+		c = sp->sp_ring[sp->sp_head];
+		SYSCALL(VERHO, &(sp->sp_lock), 0, 0);
+
+		SYSCALL(PASSERN, &(mutex[mutexSemIdx]), 0, 0);
+		setSTATUS(getSTATUS() & (~IECBITON));
+		printerDevAdd->d_data0 = c;
+		printerDevAdd->d_command = PRINTCHR;
+		devStatus = SYSCALL(IOWAIT, PRNTINT, devNo, 0);
+		setSTATUS(getSTATUS() | IECBITON);
+		SYSCALL(VERHO, &(mutex[mutexSemIdx]), 0, 0);
+
+		SYSCALL(PASSERN, &(sp->sp_lock), 0, 0);
+		sp->sp_head = (sp->sp_head + 1) % SPOOL_SIZE;
+		sp->sp_count--;
+		sp->sp_jobLen[sp->sp_jobHead]--;
+		if(sp->sp_jobLen[sp->sp_jobHead] == 0) {
+			sp->sp_jobHead = (sp->sp_jobHead + 1) % SPOOL_JOBS;
+			sp->sp_jobs--;
+		}
+		if(devStatus != READY && sp->sp_error == 0) {
+			sp->sp_error = devStatus;
+		}
+		if(sp->sp_spaceWanted) {
+			sp->sp_spaceWanted = FALSE;
+			SYSCALL(VERHO, &(sp->sp_space), 0, 0);
+		}
+		SYSCALL(VERHO, &(sp->sp_lock), 0, 0);
+	}
+}
+
+/**********************************************************
+ *  initPrintSpool
+ *
+ *  Empties the spool of every printer and creates the spooler
+ *  of each installed one. Called by test() before any U-proc
+ *  exists.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void initPrintSpool() {
+	int devNo;
+	int installed = ((devregarea_t *)RAMBASEADDR)->inst_dev[PRNTINT - DISKINT];
+	state_t daemonState;
+
+	for(devNo = 0; devNo < DEVPERINT; devNo++) {
+		printSpool[devNo].sp_head = 0;
+		printSpool[devNo].sp_count = 0;
+		printSpool[devNo].sp_jobHead = 0;
+		printSpool[devNo].sp_jobs = 0;
+		printSpool[devNo].sp_error = 0;
+		printSpool[devNo].sp_lock = 1;
+		printSpool[devNo].sp_writer = 1;
+		printSpool[devNo].sp_asleep = FALSE;
+		printSpool[devNo].sp_work = 0;
+		printSpool[devNo].sp_spaceWanted = FALSE;
+		printSpool[devNo].sp_space = 0;
+		printSpool[devNo].sp_flushWaiters = 0;
+		printSpool[devNo].sp_drained = 0;
+		if((installed & (1 << devNo)) == 0) {
+			continue;
+		}
+		daemonState.s_pc = (memaddr)printer_spooler;
+		daemonState.s_t9 = (memaddr)printer_spooler;
+		daemonState.s_a0 = devNo;
+		daemonState.s_sp = ((devregarea_t *)RAMBASEADDR)->rambase + ((devregarea_t *)RAMBASEADDR)->ramsize - ((SPOOL_STACK_FRAME + devNo) * PAGESIZE);
+		daemonState.s_status = (IEPBITON & KUPBITOFF) | IPBITS;
+		daemonState.s_entryHI = 0 << ASID_SHIFT;
+		SYSCALL(CREATETHREAD, &daemonState, NULL, 0);
+	}
+}
+
+/**********************************************************
+ *  print_flush
+ *
+ *  Blocks until every job spooled on a printer has been
+ *  printed, then reports and clears the first print error
+ *  since the last report.
+ *
+ *  Parameters:
+ *         int devNo – printer flushed
+ *
+ *  Returns:
+ *         int – 0, or the negated status of the failed PRINTCHR
+ **********************************************************/
+int print_flush(int devNo) {
+	spool_t *sp = &(printSpool[devNo]);
+	int error;
+
+	SYSCALL(PASSERN, &(sp->sp_lock), 0, 0);
+	if(sp->sp_count > 0) {
+		sp->sp_flushWaiters++;
+		SYSCALL(VERHO, &(sp->sp_lock), 0, 0);
+		SYSCALL(PASSERN, &(sp->sp_drained), 0, 0);
+		SYSCALL(PASSERN, &(sp->sp_lock), 0, 0);
+	}
+	error = sp->sp_error;
+	sp->sp_error = 0;
+	SYSCALL(VERHO, &(sp->sp_lock), 0, 0);
+	return -error;
+}
+
 /**********************************************************
  *  WRITE_TO_PRINTER
  *
- *  Writes a string to the printer device character by character.
- *  Handles errors for invalid addresses or invalid string length.
+ *  Appends a string to the spool of the printer as one job
+ *  and returns once it is spooled, waiting only while the
+ *  spool is full; the spooler of the printer prints it. The
+ *  job is spooled even if an earlier one failed: print errors
+ *  are only reported by PRINT_FLUSH.
  *
  *  Parameters:
  *         support_t *passedUpSupportStruct – pointer to the support struct
@@ -158,7 +312,7 @@ void WRITE_TO_PRINTER(support_t *passedUpSupportStruct) {
 	state_t *savedExcState = &(passedUpSupportStruct->sup_exceptState[GENERALEXCEPT]);
 
 	int devNo = passedUpSupportStruct->sup_asid - 1;
-	device_t *printerDevAdd = devAddrBase(PRNTINT, devNo);
+	spool_t *sp = &(printSpool[devNo]);
 
 	/* Error: to write to a printer device from an address outside of the requesting U-proc’s logical address space*/
 	/* Error: length less than 0*/
@@ -168,36 +322,218 @@ void WRITE_TO_PRINTER(support_t *passedUpSupportStruct) {
 		program_trap_handler(passedUpSupportStruct, NULL);
 	}
 
-	int mutexSemIdx = devSemIdx(PRNTINT, devNo, FALSE);
-	SYSCALL(PASSERN, &(mutex[mutexSemIdx]), 0, 0);
+	/* copied first: a page fault on the string must not happen holding the spool */
+	char job[STR_MAX];
+	int len = savedExcState->s_a2;
 	int i;
-	int devStatus;
-	for(i = 0; i < savedExcState->s_a2; i++) {
+	for(i = 0; i < len; i++) {
+		job[i] = *(((char *)savedExcState->s_a1) + i);
+	}
+
+	SYSCALL(PASSERN, &(sp->sp_writer), 0, 0);
+	SYSCALL(PASSERN, &(sp->sp_lock), 0, 0);
+	/* a job goes in whole, after the ones already spooled */
+	while(len > 0 && (sp->sp_jobs == SPOOL_JOBS || sp->sp_count + len > SPOOL_SIZE)) {
+		sp->sp_spaceWanted = TRUE;
+		SYSCALL(VERHO, &(sp->sp_lock), 0, 0);
+		SYSCALL(PASSERN, &(sp->sp_space), 0, 0);
+		SYSCALL(PASSERN, &(sp->sp_lock), 0, 0);
+	}
+	if(len > 0) {
+		for(i = 0; i < len; i++) {
+			sp->sp_ring[(sp->sp_head + sp->sp_count + i) % SPOOL_SIZE] = job[i];
+		}
+		sp->sp_count += len;
+		sp->sp_jobLen[(sp->sp_jobHead + sp->sp_jobs) % SPOOL_JOBS] = len;
+		sp->sp_jobs++;
+		if(sp->sp_asleep) {
+			sp->sp_asleep = FALSE;
+			SYSCALL(VERHO, &(sp->sp_work), 0, 0);
+		}
+	}
+	SYSCALL(VERHO, &(sp->sp_lock), 0, 0);
+	SYSCALL(VERHO, &(sp->sp_writer), 0, 0);
+	savedExcState->s_v0 = len;
+}
+
+/**********************************************************
+ *  PRINT_QUEUE
+ *
+ *  SYS22: returns the jobs spooled on the printer of the
+ *  U-proc and not fully printed yet.
+ *
+ *  Parameters:
+ *         support_t *passedUpSupportStruct – pointer to the support struct
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void PRINT_QUEUE(support_t *passedUpSupportStruct) {
+	spool_t *sp = &(printSpool[passedUpSupportStruct->sup_asid - 1]);
+
+	SYSCALL(PASSERN, &(sp->sp_lock), 0, 0);
+	passedUpSupportStruct->sup_exceptState[GENERALEXCEPT].s_v0 = sp->sp_jobs;
+	SYSCALL(VERHO, &(sp->sp_lock), 0, 0);
+}
+
+/**********************************************************
+ *  PRINT_FLUSH
+ *
+ *  SYS23: blocks the U-proc until every job it spooled with
+ *  SYS11 has been printed. Returns 0, or the negated status of
+ *  the first PRINTCHR failed since the last SYS23, the only
+ *  way print errors are reported.
+ *
+ *  Parameters:
+ *         support_t *passedUpSupportStruct – pointer to the support struct
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void PRINT_FLUSH(support_t *passedUpSupportStruct) {
+	passedUpSupportStruct->sup_exceptState[GENERALEXCEPT].s_v0 = print_flush(passedUpSupportStruct->sup_asid - 1);
+}
+
+/**********************************************************
+ *  term_output_daemon
+ *
+ *  Body of the kernel-mode process draining the transmit ring
+ *  of one terminal. Each character is transmitted under the
+ *  terminal mutex, so other writers of the device interleave
+ *  only between characters, and is dropped from the ring once
+ *  its interrupt arrived, so a flush returns after the last
+ *  character actually left.
+ *
+ *  Parameters:
+ *         int devNo – terminal drained
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void term_output_daemon(int devNo) {
+	termtx_t *tx = &(termTx[devNo]);
+	device_t *termDevAdd = devAddrBase(TERMINT, devNo);
+	int mutexSemIdx = devSemIdx(TERMINT, devNo, FALSE);
+	int transmStatus;
+	char c;
+
+	while(TRUE) {
+		SYSCALL(PASSERN, &(tx->tx_lock), 0, 0);
+		if(tx->tx_count == 0) {
+			while(tx->tx_flushWaiters > 0) {
+				tx->tx_flushWaiters--;
+				SYSCALL(VERHO, &(tx->tx_drained), 0, 0);
+			}
+			tx->tx_asleep = TRUE;
+			SYSCALL(VERHO, &(tx->tx_lock), 0, 0);
+			SYSCALL(PASSERN, &(tx->tx_work), 0, 0);
+			continue;
+		}
+		c = tx->tx_ring[tx->tx_head];
+		SYSCALL(VERHO, &(tx->tx_lock), 0, 0);
+
+		SYSCALL(PASSERN, &(mutex[mutexSemIdx]), 0, 0);
 		setSTATUS(getSTATUS() & (~IECBITON));
-		printerDevAdd->d_data0 = *(((char *)savedExcState->s_a1) + i); /*calculate address and accessing the current char*/
-		printerDevAdd->d_command = PRINTCHR;
-		devStatus = SYSCALL(IOWAIT, PRNTINT, devNo, 0); /*call SYSCALL IOWAIT to block until interrupt*/
+		termDevAdd->t_transm_command = (c << TRANS_COMMAND_SHIFT) + TRANSMIT_COMMAND;
+		transmStatus = SYSCALL(IOWAIT, TERMINT, devNo, FALSE);
 		setSTATUS(getSTATUS() | IECBITON);
-		if(devStatus != READY) { /* operation ends with a status other than "Device Ready" -- this is printer, not terminal */
-			savedExcState->s_v0 = -devStatus;
-			break;
+		SYSCALL(VERHO, &(mutex[mutexSemIdx]), 0, 0);
+
+		SYSCALL(PASSERN, &(tx->tx_lock), 0, 0);
+		tx->tx_head = (tx->tx_head + 1) % TERM_RING_SIZE;
+		tx->tx_count--;
+		if((transmStatus & STATUS_CHAR_MASK) != CHAR_TRANSMITTED && tx->tx_error == 0) {
+			tx->tx_error = transmStatus;
 		}
+		if(tx->tx_spaceWanted) {
+			tx->tx_spaceWanted = FALSE;
+			SYSCALL(VERHO, &(tx->tx_space), 0, 0);
+		}
+		SYSCALL(VERHO, &(tx->tx_lock), 0, 0);
+	}
+}
+
+/**********************************************************
+ *  initTermOutput
+ *
+ *  Empties the transmit ring of every terminal and creates
+ *  the output daemon of each installed one. Called by test()
+ *  before any U-proc exists.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void initTermOutput() {
+	int devNo;
+	int installed = ((devregarea_t *)RAMBASEADDR)->inst_dev[TERMINT - DISKINT];
+	state_t daemonState;
+
+	for(devNo = 0; devNo < DEVPERINT; devNo++) {
+		termTx[devNo].tx_head = 0;
+		termTx[devNo].tx_count = 0;
+		termTx[devNo].tx_error = 0;
+		termTx[devNo].tx_lock = 1;
+		termTx[devNo].tx_writer = 1;
+		termTx[devNo].tx_asleep = FALSE;
+		termTx[devNo].tx_work = 0;
+		termTx[devNo].tx_spaceWanted = FALSE;
+		termTx[devNo].tx_space = 0;
+		termTx[devNo].tx_flushWaiters = 0;
+		termTx[devNo].tx_drained = 0;
+		if((installed & (1 << devNo)) == 0) {
+			continue;
+		}
+		daemonState.s_pc = (memaddr)term_output_daemon;
+		daemonState.s_t9 = (memaddr)term_output_daemon;
+		daemonState.s_a0 = devNo;
+		daemonState.s_sp = ((devregarea_t *)RAMBASEADDR)->rambase + ((devregarea_t *)RAMBASEADDR)->ramsize - ((TERMTX_STACK_FRAME + devNo) * PAGESIZE);
+		daemonState.s_status = (IEPBITON & KUPBITOFF) | IPBITS;
+		daemonState.s_entryHI = 0 << ASID_SHIFT;
+		SYSCALL(CREATETHREAD, &daemonState, NULL, 0);
 	}
+}
 
-	if(devStatus == READY) {
-		savedExcState->s_v0 = i;
-		;
-	} else {
-		savedExcState->s_v0 = -devStatus;
+/**********************************************************
+ *  term_flush
+ *
+ *  Blocks until every character queued on a terminal has
+ *  been transmitted, then reports and clears the first
+ *  transmission error since the last report.
+ *
+ *  Parameters:
+ *         int devNo – terminal flushed
+ *
+ *  Returns:
+ *         int – 0, or the negated status of the failed transmission
+ **********************************************************/
+int term_flush(int devNo) {
+	termtx_t *tx = &(termTx[devNo]);
+	int error;
+
+	SYSCALL(PASSERN, &(tx->tx_lock), 0, 0);
+	if(tx->tx_count > 0) {
+		tx->tx_flushWaiters++;
+		SYSCALL(VERHO, &(tx->tx_lock), 0, 0);
+		SYSCALL(PASSERN, &(tx->tx_drained), 0, 0);
+		SYSCALL(PASSERN, &(tx->tx_lock), 0, 0);
 	}
-	SYSCALL(VERHO, &(mutex[mutexSemIdx]), 0, 0);
+	error = tx->tx_error;
+	tx->tx_error = 0;
+	SYSCALL(VERHO, &(tx->tx_lock), 0, 0);
+	return -error;
 }
 
 /**********************************************************
  *  WRITE_TO_TERMINAL
  *
- *  Writes a string to the terminal device. Sends each character
- *  one at a time using the TRANSMITCHAR command.
+ *  Queues a string on the transmit ring of the terminal and
+ *  returns once it is queued, waiting only while the ring is
+ *  full; the output daemon of the terminal transmits it. A
+ *  transmission error of an earlier string not reported yet
+ *  is returned instead, as by FLUSH_TERMINAL.
  *
  *  Parameters:
  *         support_t *passedUpSupportStruct – pointer to the support struct
@@ -213,7 +549,7 @@ void WRITE_TO_TERMINAL(support_t *passedUpSupportStruct) {
 	state_t *savedExcState = &(passedUpSupportStruct->sup_exceptState[GENERALEXCEPT]);
 
 	int devNo = passedUpSupportStruct->sup_asid - 1;
-	device_t *termDevAdd = devAddrBase(TERMINT, devNo);
+	termtx_t *tx = &(termTx[devNo]);
 
 	/* Error: to write to a printer device from an address outside of the requesting U-proc’s logical address space*/
 	/* Error: length less than 0*/
@@ -222,35 +558,195 @@ void WRITE_TO_TERMINAL(support_t *passedUpSupportStruct) {
 		program_trap_handler(passedUpSupportStruct, NULL);
 	}
 
-	int mutexSemIdx = devSemIdx(TERMINT, devNo, FALSE);
-	SYSCALL(PASSERN, &(mutex[mutexSemIdx]), 0, 0);
+	/* copied first: a page fault on the string must not happen holding the ring */
+	char line[STR_MAX];
+	int len = savedExcState->s_a2;
 	int i;
-	int transmStatus;
-	for(i = 0; i < savedExcState->s_a2; i++) {
+	for(i = 0; i < len; i++) {
+		line[i] = *(((char *)savedExcState->s_a1) + i);
+	}
+
+	SYSCALL(PASSERN, &(tx->tx_writer), 0, 0);
+	SYSCALL(PASSERN, &(tx->tx_lock), 0, 0);
+	if(tx->tx_error != 0) {
+		savedExcState->s_v0 = -(tx->tx_error);
+		tx->tx_error = 0;
+		SYSCALL(VERHO, &(tx->tx_lock), 0, 0);
+		SYSCALL(VERHO, &(tx->tx_writer), 0, 0);
+		return;
+	}
+	i = 0;
+	while(i < len) {
+		while(i < len && tx->tx_count < TERM_RING_SIZE) {
+			tx->tx_ring[(tx->tx_head + tx->tx_count) % TERM_RING_SIZE] = line[i];
+			tx->tx_count++;
+			i++;
+		}
+		if(tx->tx_asleep) {
+			tx->tx_asleep = FALSE;
+			SYSCALL(VERHO, &(tx->tx_work), 0, 0);
+		}
+		if(i < len) {
+			/* the ring is full, the daemon wakes us once it sent a character */
+			tx->tx_spaceWanted = TRUE;
+			SYSCALL(VERHO, &(tx->tx_lock), 0, 0);
+			SYSCALL(PASSERN, &(tx->tx_space), 0, 0);
+			SYSCALL(PASSERN, &(tx->tx_lock), 0, 0);
+		}
+	}
+	SYSCALL(VERHO, &(tx->tx_lock), 0, 0);
+	SYSCALL(VERHO, &(tx->tx_writer), 0, 0);
+	savedExcState->s_v0 = len;
+}
+
+/**********************************************************
+ *  FLUSH_TERMINAL
+ *
+ *  SYS21: blocks the U-proc until every string it wrote with
+ *  SYS12 has left its terminal. Returns 0, or the negated
+ *  status of the first failed transmission.
+ *
+ *  Parameters:
+ *         support_t *passedUpSupportStruct – pointer to the support struct
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void FLUSH_TERMINAL(support_t *passedUpSupportStruct) {
+	passedUpSupportStruct->sup_exceptState[GENERALEXCEPT].s_v0 = term_flush(passedUpSupportStruct->sup_asid - 1);
+}
+
+/**********************************************************
+ *  helper_rx_char
+ *
+ *  Line discipline of the terminal input: adds a received
+ *  character to the line being typed, or erases the last one
+ *  on BACKSPACE or DEL. A newline, or a line reaching STR_MAX
+ *  characters, completes the line and wakes a SYS13. Called
+ *  with the ring lock held.
+ *
+ *  Parameters:
+ *         termrx_t *rx – input ring of the terminal
+ *         char c – character received
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_rx_char(termrx_t *rx, char c) {
+	if(c == TERM_ERASE || c == TERM_DELETE) {
+		if(rx->rx_partial > 0) {
+			rx->rx_partial--;
+			rx->rx_count--;
+		}
+		return;
+	}
+	if(rx->rx_count == TERM_RING_SIZE) {
+		/* completed lines nobody read fill the ring */
+		termCharsDropped++;
+		return;
+	}
+	rx->rx_ring[(rx->rx_head + rx->rx_count) % TERM_RING_SIZE] = c;
+	rx->rx_count++;
+	rx->rx_partial++;
+	if(c == NEW_LINE || rx->rx_partial == STR_MAX) {
+		rx->rx_partial = 0;
+		rx->rx_lines++;
+		SYSCALL(VERHO, &(rx->rx_lineReady), 0, 0);
+	}
+}
+
+/**********************************************************
+ *  term_input_daemon
+ *
+ *  Body of the kernel-mode process keeping a RECEIVECHAR
+ *  outstanding on one terminal at all times, so what is typed
+ *  before a SYS13 is not lost, and passing each character to
+ *  the line discipline as soon as its interrupt arrives. A
+ *  failed receive is reported to the next SYS13 and retried
+ *  after a pseudo-clock tick.
+ *
+ *  Parameters:
+ *         int devNo – terminal read
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void term_input_daemon(int devNo) {
+	termrx_t *rx = &(termRx[devNo]);
+	device_t *termDevAdd = devAddrBase(TERMINT, devNo);
+	int mutexSemIdx = devSemIdx(TERMINT, devNo, TRUE);
+	int recvStatusField;
+
+	while(TRUE) {
+		SYSCALL(PASSERN, &(mutex[mutexSemIdx]), 0, 0);
 		setSTATUS(getSTATUS() & (~IECBITON));
-		termDevAdd->t_transm_command = (*(((char *)savedExcState->s_a1) + i) << TRANS_COMMAND_SHIFT) + TRANSMIT_COMMAND;
-		transmStatus = SYSCALL(IOWAIT, TERMINT, devNo, FALSE); /*call SYSCALL IOWAIT to block until interrupt*/
+		termDevAdd->t_recv_command = RECEIVE_COMMAND;
+		recvStatusField = SYSCALL(IOWAIT, TERMINT, devNo, TRUE);
 		setSTATUS(getSTATUS() | IECBITON);
-		if((transmStatus & STATUS_CHAR_MASK) != CHAR_TRANSMITTED) { /* operation ends with a status other than Character Transmitted */
-			savedExcState->s_v0 = -transmStatus;
-			break;
+		SYSCALL(VERHO, &(mutex[mutexSemIdx]), 0, 0);
+
+		SYSCALL(PASSERN, &(rx->rx_lock), 0, 0);
+		if((recvStatusField & STATUS_CHAR_MASK) != CHAR_RECIEVED) {
+			if(rx->rx_error == 0) {
+				rx->rx_error = recvStatusField & STATUS_CHAR_MASK;
+				SYSCALL(VERHO, &(rx->rx_lineReady), 0, 0);
+			}
+			SYSCALL(VERHO, &(rx->rx_lock), 0, 0);
+			SYSCALL(CLOCKWAIT, 0, 0, 0);
+			continue;
 		}
+		helper_rx_char(rx, (recvStatusField & RECEIVE_CHAR_MASK) >> RECEIVE_COMMAND_SHIFT);
+		SYSCALL(VERHO, &(rx->rx_lock), 0, 0);
 	}
+}
 
-	if((transmStatus & STATUS_CHAR_MASK) == CHAR_TRANSMITTED) {
-		savedExcState->s_v0 = i;
-		;
-	} else {
-		savedExcState->s_v0 = -transmStatus;
+/**********************************************************
+ *  initTermInput
+ *
+ *  Empties the input ring of every terminal and creates the
+ *  input daemon of each installed one. Called by test()
+ *  before any U-proc exists.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void initTermInput() {
+	int devNo;
+	int installed = ((devregarea_t *)RAMBASEADDR)->inst_dev[TERMINT - DISKINT];
+	state_t daemonState;
+
+	termCharsDropped = 0;
+	for(devNo = 0; devNo < DEVPERINT; devNo++) {
+		termRx[devNo].rx_head = 0;
+		termRx[devNo].rx_count = 0;
+		termRx[devNo].rx_partial = 0;
+		termRx[devNo].rx_lines = 0;
+		termRx[devNo].rx_error = 0;
+		termRx[devNo].rx_lock = 1;
+		termRx[devNo].rx_lineReady = 0;
+		if((installed & (1 << devNo)) == 0) {
+			continue;
+		}
+		daemonState.s_pc = (memaddr)term_input_daemon;
+		daemonState.s_t9 = (memaddr)term_input_daemon;
+		daemonState.s_a0 = devNo;
+		daemonState.s_sp = ((devregarea_t *)RAMBASEADDR)->rambase + ((devregarea_t *)RAMBASEADDR)->ramsize - ((TERMRX_STACK_FRAME + devNo) * PAGESIZE);
+		daemonState.s_status = (IEPBITON & KUPBITOFF) | IPBITS;
+		daemonState.s_entryHI = 0 << ASID_SHIFT;
+		SYSCALL(CREATETHREAD, &daemonState, NULL, 0);
 	}
-	SYSCALL(VERHO, &(mutex[mutexSemIdx]), 0, 0);
 }
 
 /**********************************************************
  *  READ_FROM_TERMINAL
  *
- *  Reads characters from the terminal input device until newline.
- *  Stores characters in the buffer provided by the user process.
+ *  Waits for a line completed in the input ring of the
+ *  terminal and copies it, its newline included, into the
+ *  buffer of the U-proc. Returns the characters copied, or the
+ *  negated status of a failed receive.
  *
  *  Parameters:
  *         support_t *passedUpSupportStruct – pointer to the support struct
@@ -259,11 +755,10 @@ void WRITE_TO_TERMINAL(support_t *passedUpSupportStruct) {
  *
  **********************************************************/
 void READ_FROM_TERMINAL(support_t *passedUpSupportStruct) {
-	/* Get the terminal device register */
 	state_t *savedExcState = &(passedUpSupportStruct->sup_exceptState[GENERALEXCEPT]);
 
 	int devNo = passedUpSupportStruct->sup_asid - 1;
-	device_t *termDevAdd = devAddrBase(TERMINT, devNo);
+	termrx_t *rx = &(termRx[devNo]);
 
 	/* Error: to write to a printer device from an address outside of the requesting U-proc’s logical address space*/
 	/* Error: length less than 0*/
@@ -272,42 +767,40 @@ void READ_FROM_TERMINAL(support_t *passedUpSupportStruct) {
 		program_trap_handler(passedUpSupportStruct, NULL);
 	}
 
-	int mutexSemIdx = devSemIdx(TERMINT, devNo, TRUE);
-	SYSCALL(PASSERN, &(mutex[mutexSemIdx]), 0, 0);
-
-	char *stringAdd = savedExcState->s_a1;
+	char line[STR_MAX];
+	int len = 0;
+	int i;
 
-	int i = 0;
-	int recvStatusField;
-	int recvStatus;
-	char recvChar = 'a';
-	while(recvChar != NEW_LINE) {
-		setSTATUS(getSTATUS() & (~IECBITON));
-		termDevAdd->t_recv_command = RECEIVE_COMMAND;
-		recvStatusField = SYSCALL(IOWAIT, TERMINT, devNo, TRUE); /*call SYSCALL IOWAIT to block until interrupt*/
-		setSTATUS(getSTATUS() | IECBITON);
-		recvChar = (recvStatusField & RECEIVE_CHAR_MASK) >> RECEIVE_COMMAND_SHIFT;
-		recvStatus = recvStatusField & STATUS_CHAR_MASK;
-		stringAdd[i] = recvChar; /* write the char into the string buffer array */
-		i++;
-		if(recvStatus != CHAR_RECIEVED) { /* operation ends with a status other than Character Received */
-			savedExcState->s_v0 = -recvStatus;
-			break;
-		}
+	SYSCALL(PASSERN, &(rx->rx_lineReady), 0, 0);
+	SYSCALL(PASSERN, &(rx->rx_lock), 0, 0);
+	if(rx->rx_lines == 0) {
+		/* woken by a failed receive */
+		savedExcState->s_v0 = -(rx->rx_error);
+		rx->rx_error = 0;
+		SYSCALL(VERHO, &(rx->rx_lock), 0, 0);
+		return;
 	}
+	do {
+		line[len] = rx->rx_ring[rx->rx_head];
+		rx->rx_head = (rx->rx_head + 1) % TERM_RING_SIZE;
+		rx->rx_count--;
+		len++;
+	} while(line[len - 1] != NEW_LINE && len < STR_MAX);
+	rx->rx_lines--;
+	SYSCALL(VERHO, &(rx->rx_lock), 0, 0);
 
-	if(recvStatus == CHAR_RECIEVED) {
-		savedExcState->s_v0 = i;
-	} else {
-		savedExcState->s_v0 = -recvStatus;
+	/* copied outside the ring lock: the buffer may fault */
+	char *stringAdd = savedExcState->s_a1;
+	for(i = 0; i < len; i++) {
+		stringAdd[i] = line[i];
 	}
-	SYSCALL(VERHO, &(mutex[mutexSemIdx]), 0, 0);
+	savedExcState->s_v0 = len;
 }
 
 /**********************************************************
  *  syscall_handler
  *
- *  Dispatches system calls from user processes. Handles SYS9 to SYS13.
+ *  Dispatches system calls from user processes. Handles SYS9 to SYS18 and SYS21 to SYS24.
  *  If an unknown system call is encountered, invokes the trap handler.
  *
  *  Parameters:
@@ -346,6 +839,17 @@ void syscall_handler(support_t *passedUpSupportStruct) {
 			helper_return_control(passedUpSupportStruct);
 		case 18:
 			DELAY(passedUpSupportStruct);
+		case 21:
+			FLUSH_TERMINAL(passedUpSupportStruct);
+			helper_return_control(passedUpSupportStruct);
+		case 22:
+			PRINT_QUEUE(passedUpSupportStruct);
+			helper_return_control(passedUpSupportStruct);
+		case 23:
+			PRINT_FLUSH(passedUpSupportStruct);
+			helper_return_control(passedUpSupportStruct);
+		case 24:
+			DELAY_US(passedUpSupportStruct);
 		default: /*the case where the process tried to do SYS 8- in user mode*/
 			program_trap_handler(passedUpSupportStruct, NULL);
 	}
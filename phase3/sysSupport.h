@@ -15,7 +15,14 @@
 #include "../h/types.h"
 #include "../h/const.h"
 
+extern int termCharsDropped;
+
 void general_exception_handler();
 void program_trap_handler(support_t *passedUpSupportStruct, semd_t *heldSemd);
+void initPrintSpool();
+int print_flush(int devNo);
+void initTermOutput();
+void initTermInput();
+int term_flush(int devNo);
 
 #endif
\ No newline at end of file
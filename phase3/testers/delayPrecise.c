@@ -0,0 +1,34 @@
+/*	Microsecond delays: sleeps a few times with SYS24 and checks it was
+	never woken early. How late each wake-up was appears in the end of
+	run report */
+
+#include "h/localLibumps.h"
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define ROUNDS 5
+#define DELAYUS 250000	/* a quarter of a second, not a whole pseudo-clock tick count */
+
+void main() {
+	int i;
+	int errors = 0;
+	unsigned int before, after;
+
+	print(WRITETERMINAL, "delayPrecise starts\n");
+
+	for(i = 0; i < ROUNDS; i++) {
+		before = SYSCALL(GET_TOD, 0, 0, 0);
+		SYSCALL(DELAY_US, DELAYUS, 0, 0);
+		after = SYSCALL(GET_TOD, 0, 0, 0);
+		if(after - before < DELAYUS)
+			errors++;
+	}
+
+	if(errors == 0)
+		print(WRITETERMINAL, "delayPrecise ok: no early wake-up\n");
+	else
+		print(WRITETERMINAL, "delayPrecise error: woken before the deadline\n");
+
+	print(WRITETERMINAL, "delayPrecise: completed\n");
+	SYSCALL(TERMINATE, 0, 0, 0);
+}
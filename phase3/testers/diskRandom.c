@@ -0,0 +1,77 @@
+/*	Random sector Disk Put and Disk Get, meant to be loaded on all eight U-procs
+	at once so that their requests pile up in the queue of disk 1 */
+
+#include "h/localLibumps.h"
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define DISKNO 1
+#define SECTORS 128	/* spread over the first cylinders of the disk */
+#define IOCOUNT 40
+
+/* prints "<label><value> ms\n" */
+void printMs(char *label, unsigned int value) {
+	char line[64];
+	char digits[12];
+	int len = 0;
+	int nDigits = 0;
+
+	while(*label != EOS) {
+		line[len++] = *label;
+		label++;
+	}
+	do {
+		digits[nDigits++] = '0' + (value % 10);
+		value = value / 10;
+	} while(value > 0);
+	while(nDigits > 0)
+		line[len++] = digits[--nDigits];
+	line[len++] = ' ';
+	line[len++] = 'm';
+	line[len++] = 's';
+	line[len++] = '\n';
+	line[len] = EOS;
+	print(WRITETERMINAL, line);
+}
+
+void main() {
+	int i;
+	int dstatus;
+	int errors = 0;
+	int *buffer;
+	unsigned int seed, sector, start;
+
+	/* page aligned, so the disk transfers straight to and from the U-proc's frame */
+	buffer = (int *)(SEG2 + (20 * PAGESIZE));
+
+	print(WRITETERMINAL, "diskRandom starts\n");
+	seed = SYSCALL(GET_TOD, 0, 0, 0);
+	start = seed;
+
+	for(i = 0; i < IOCOUNT; i++) {
+		seed = seed * 1103515245 + 12345;
+		sector = (seed >> 16) % SECTORS;
+
+		/* any U-proc writing this sector writes its number in the first word */
+		buffer[0] = sector;
+		buffer[1] = i;
+		dstatus = SYSCALL(DISK_PUT, (int)buffer, DISKNO, sector);
+		if(dstatus != READY)
+			errors++;
+
+		buffer[0] = -1;
+		dstatus = SYSCALL(DISK_GET, (int)buffer, DISKNO, sector);
+		if(dstatus != READY || buffer[0] != sector)
+			errors++;
+	}
+
+	if(errors == 0)
+		print(WRITETERMINAL, "diskRandom ok: random sector readback\n");
+	else
+		print(WRITETERMINAL, "diskRandom error: bad random sector readback\n");
+
+	printMs("diskRandom time: ", (SYSCALL(GET_TOD, 0, 0, 0) - start) / 1000);
+
+	print(WRITETERMINAL, "diskRandom: completed\n");
+	SYSCALL(TERMINATE, 0, 0, 0);
+}
@@ -30,6 +30,10 @@
 #define DELAY 18
 #define PSEMVIRT 19
 #define VSEMVIRT 20
+#define TERMFLUSH 21
+#define PRINTQUEUE 22
+#define PRINTFLUSH 23
+#define DELAY_US 24
 
 #define SEG0 0x00000000
 #define SEG1 0x40000000
@@ -0,0 +1,35 @@
+/*	Printer spool: queues a few jobs on its printer (SYS11), which should
+	return once each job is spooled, checks they are still queued (SYS22),
+	then waits for the printer to drain them (SYS23) */
+
+#include "h/localLibumps.h"
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define JOBS 8
+
+void main() {
+	int i;
+	int errors = 0;
+	int queued;
+
+	print(WRITETERMINAL, "printSpool starts\n");
+
+	for(i = 0; i < JOBS; i++) {
+		if(SYSCALL(WRITEPRINTER, (int)"printSpool: one spooled job\n", 28, 0) != 28)
+			errors++;
+	}
+	queued = SYSCALL(PRINTQUEUE, 0, 0, 0);
+	if(SYSCALL(PRINTFLUSH, 0, 0, 0) != 0)
+		errors++;
+
+	if(errors != 0)
+		print(WRITETERMINAL, "printSpool error: jobs not printed\n");
+	else if(queued == 0 || SYSCALL(PRINTQUEUE, 0, 0, 0) != 0)
+		print(WRITETERMINAL, "printSpool error: bad queue depth\n");
+	else
+		print(WRITETERMINAL, "printSpool ok: jobs spooled then printed\n");
+
+	print(WRITETERMINAL, "printSpool: completed\n");
+	SYSCALL(TERMINATE, 0, 0, 0);
+}
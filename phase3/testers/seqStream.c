@@ -0,0 +1,45 @@
+/*	Sequential Disk Get stream: after writing 100 consecutive sectors of
+	disk 1, reads them back in order. Past the first reads, each block
+	should come from the read-ahead cache of the support level */
+
+#include "h/localLibumps.h"
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define DISKNO 1
+#define FIRSTSECTOR 200	/* away from the sectors used by diskIOtest and diskRandom */
+#define BLOCKS 100
+
+void main() {
+	int i;
+	int dstatus;
+	int errors = 0;
+	int *buffer;
+
+	buffer = (int *)(SEG2 + (20 * PAGESIZE));
+
+	print(WRITETERMINAL, "seqStream starts\n");
+
+	for(i = 0; i < BLOCKS; i++) {
+		buffer[0] = FIRSTSECTOR + i;
+		buffer[(PAGESIZE / WORDLEN) - 1] = i;
+		dstatus = SYSCALL(DISK_PUT, (int)buffer, DISKNO, FIRSTSECTOR + i);
+		if(dstatus != READY)
+			errors++;
+	}
+
+	for(i = 0; i < BLOCKS; i++) {
+		buffer[0] = -1;
+		dstatus = SYSCALL(DISK_GET, (int)buffer, DISKNO, FIRSTSECTOR + i);
+		if(dstatus != READY || buffer[0] != FIRSTSECTOR + i || buffer[(PAGESIZE / WORDLEN) - 1] != i)
+			errors++;
+	}
+
+	if(errors == 0)
+		print(WRITETERMINAL, "seqStream ok: sequential readback\n");
+	else
+		print(WRITETERMINAL, "seqStream error: bad sequential readback\n");
+
+	print(WRITETERMINAL, "seqStream: completed\n");
+	SYSCALL(TERMINATE, 0, 0, 0);
+}
@@ -0,0 +1,38 @@
+/*	Terminal flush: queues a burst of lines with SYS12, which should return
+	as soon as each line is in the transmit ring, then waits for them to
+	leave the terminal with SYS21 */
+
+#include "h/localLibumps.h"
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define LINES 20
+
+void main() {
+	int i;
+	int status;
+	int errors = 0;
+	unsigned int queued, drained;
+
+	print(WRITETERMINAL, "termFlush starts\n");
+
+	for(i = 0; i < LINES; i++) {
+		status = SYSCALL(WRITETERMINAL, (int)"termFlush: a line of the burst\n", 30, 0);
+		if(status != 30)
+			errors++;
+	}
+	queued = SYSCALL(GET_TOD, 0, 0, 0);
+	if(SYSCALL(TERMFLUSH, 0, 0, 0) != 0)
+		errors++;
+	drained = SYSCALL(GET_TOD, 0, 0, 0);
+
+	if(errors != 0)
+		print(WRITETERMINAL, "termFlush error: burst not transmitted\n");
+	else if(queued >= drained)
+		print(WRITETERMINAL, "termFlush error: SYS12 waited for the terminal\n");
+	else
+		print(WRITETERMINAL, "termFlush ok: burst queued before it drained\n");
+
+	print(WRITETERMINAL, "termFlush: completed\n");
+	SYSCALL(TERMINATE, 0, 0, 0);
+}
@@ -13,6 +13,34 @@
  *  Additionally, this module maintains:
  *  - A swap pool table that tracks which physical frames are currently in use
  *  - A swap pool semaphore used to ensure synchronized access to the swap pool
+ *  - Page fault counters, reported by test() at the end of the run
+ *
+ *  The frame to replace is chosen by FIFO or, by default, by Clock (second
+ *  chance), see PAGE_REPLACE_POLICY. The reference bit of a frame is set when
+ *  uTLB_RefillHandler loads its page in the TLB. When the clock hand clears a
+ *  reference bit it also drops the page from the TLB, so a page still in use
+ *  refills the TLB, and gets its reference bit set, again.
+ *
+ *  The TLB is never cleared as a whole by the Pager: the slot of an evicted
+ *  page is found with TLBP and dropped, and a page brought in (or given write
+ *  permission) is written over its own slot, or a random one.
+ *
+ *  Pages are mapped read-only (D bit off) when they are brought in. The first
+ *  write raises a TLB-Modification exception, which only sets the D bit of the
+ *  page; an evicted page is written back to the swap disk only if it is dirty.
+ *
+ *  The swap disk is filled lazily: a page is read from the flash of its
+ *  U-proc until it has been written back once, after which its copy on the
+ *  swap disk is the current one (see pagesOnDisk). Build with
+ *  EAGER_BACKING_STORE=1 to copy every flash to the swap disk at boot instead.
+ *
+ *  pin_user_page and unpin_user_page let the device SYSCALLs point a DMA
+ *  transfer straight at the frame of a user buffer: a pinned frame is
+ *  never replaced or cleaned until the transfer is over.
+ *
+ *  A kernel-mode page cleaner, created by initPageCleaner, writes back the
+ *  dirty pages just ahead of the clock hand while free frames are low, so
+ *  most evictions find a clean page and the fault only waits for its read.
  *
  *
  *      Modified by Phuong and Oghap on March 2025
@@ -25,10 +53,28 @@
 #include "../phase4/devSupport.h"
 
 #include "../phase2/initial.h"
+#include "../phase2/interrupts.h"
 
 swapPoolFrame_t swapPoolTable[SWAP_POOL_SIZE];
 int swapPoolSema4;
 
+int pageFaults;         /* page faults handled by the Pager */
+int pageEvictions;      /* of which had to evict an occupied frame */
+int pageSecondChances;  /* referenced frames skipped by the clock hand */
+int pageDirtied;        /* TLB-Modification exceptions turned into a write permission */
+int pageWritesAvoided;  /* evictions of clean pages, not written back */
+int tlbRefills[NCPU];   /* TLB-Refill events handled by uTLB_RefillHandler on each processor */
+int pagesCleaned;       /* dirty pages written back ahead of eviction by the page cleaner */
+int pagesFromFlash;     /* page-ins served by the flash of the U-proc, never written back yet */
+cpu_t firstUserTOD;     /* TOD when the first page-in returned to a U-proc, 0 before */
+
+/* bit i of pagesOnDisk[asid] is set once page i of that U-proc was written back to the swap disk */
+HIDDEN unsigned int pagesOnDisk[UPROC_NUM + 1];
+
+HIDDEN int clockHand;     /* next frame page_replace looks at */
+HIDDEN int cleanerSem;    /* the page cleaner sleeps here until the Pager runs short of frames */
+HIDDEN int cleanerAsleep; /* TRUE while the page cleaner waits on cleanerSem */
+
 void debugCheckDskDimension(int a0, int a1, int a2, int a3){
 
 }
@@ -56,8 +102,147 @@ void initSwapStruct() {
 		swapPoolTable[i].ASID = -1;
 		swapPoolTable[i].VPN = -1;
 		swapPoolTable[i].matchingPgTableEntry = NULL;
+		swapPoolTable[i].referenced = FALSE;
+		swapPoolTable[i].pinned = 0;
+		swapPoolTable[i].state = FRAME_FREE;
+		swapPoolTable[i].waitSem = 0;
+		swapPoolTable[i].waiters = 0;
 	}
 	swapPoolSema4 = 1;
+	clockHand = 0;
+	for(i = 0; i <= UPROC_NUM; i++) {
+		pagesOnDisk[i] = 0;
+	}
+	pagesFromFlash = 0;
+	firstUserTOD = 0;
+	pageFaults = 0;
+	pageEvictions = 0;
+	pageSecondChances = 0;
+	pageDirtied = 0;
+	pageWritesAvoided = 0;
+	for(i = 0; i < NCPU; i++) {
+		tlbRefills[i] = 0;
+	}
+}
+
+/**********************************************************
+ *  helper_frame_index
+ *
+ *  Gives the Swap Pool table index of the frame a Page Table
+ *  entry maps.
+ *
+ *  Parameters:
+ *         unsigned int entryLo – EntryLo of a valid entry
+ *
+ *  Returns:
+ *         int – index of the frame in swapPoolTable
+ **********************************************************/
+HIDDEN int helper_frame_index(unsigned int entryLo) {
+	return ((entryLo & PFN_MASK) - (SWAP_POOL_START)) / PAGESIZE;
+}
+
+/**********************************************************
+ *  helper_tlb_shootdown
+ *
+ *  With NCPU > 1, the page being evicted may still be mapped
+ *  in the TLB of another processor: sends every other processor
+ *  an IPI_TLBFLUSH and spins until each one has cleared its TLB,
+ *  so the frame is not written back or reused while a stale
+ *  entry can still reach it. Called with interrupts disabled,
+ *  after the Page Table entry was changed.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_tlb_shootdown() {
+#if NCPU > 1
+	int cpu;
+	unsigned int seen[NCPU];
+	int others = ((1 << NCPU) - 1) & ~(1 << CPUID());
+	/* any flush counted after this point happens after the entry was changed */
+	for(cpu = 0; cpu < NCPU; cpu++) {
+		seen[cpu] = tlbFlushGen[cpu];
+	}
+	*((memaddr *)IPI_OUTBOX) = (others << IPI_RECIPIENT_SHIFT) | IPI_TLBFLUSH;
+	for(cpu = 0; cpu < NCPU; cpu++) {
+		if((others & (1 << cpu)) != 0) {
+			while(tlbFlushGen[cpu] == seen[cpu]) {
+				;
+			}
+		}
+	}
+#endif
+}
+
+/**********************************************************
+ *  helper_tlb_probe
+ *
+ *  Looks for the TLB slot caching a page. Leaves EntryHi set
+ *  to the page and, if found, Index set to its slot.
+ *  Interrupts must be disabled.
+ *
+ *  Parameters:
+ *         unsigned int entryHi – VPN and ASID of the page
+ *
+ *  Returns:
+ *         TRUE if the page is in the TLB, FALSE otherwise
+ **********************************************************/
+HIDDEN int helper_tlb_probe(unsigned int entryHi) {
+	setENTRYHI(entryHi);
+	TLBP();
+	return (getINDEX() & TLBPROBEFAIL) == 0;
+}
+
+/**********************************************************
+ *  helper_tlb_drop
+ *
+ *  Removes a page from the TLB, if it is cached there, by
+ *  overwriting its slot with an entry that matches nothing,
+ *  so the next access to the page is a TLB-Refill.
+ *  Interrupts must be disabled.
+ *
+ *  Parameters:
+ *         unsigned int entryHi – VPN and ASID of the page
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_tlb_drop(unsigned int entryHi) {
+	unsigned int savedEntryHi = getENTRYHI();
+	if(helper_tlb_probe(entryHi)) {
+		setENTRYHI(TLBNOMATCHHI);
+		setENTRYLO(ALLOFF);
+		TLBWI();
+	}
+	setENTRYHI(savedEntryHi);
+}
+
+/**********************************************************
+ *  helper_tlb_write
+ *
+ *  Writes a Page Table entry into the TLB: over the slot
+ *  already caching the page, or a random slot otherwise.
+ *  Interrupts must be disabled.
+ *
+ *  Parameters:
+ *         pte_t *pte – the Page Table entry to cache
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_tlb_write(pte_t *pte) {
+	unsigned int savedEntryHi = getENTRYHI();
+	int present = helper_tlb_probe(pte->EntryHi);
+	setENTRYLO(pte->EntryLo);
+	if(present) {
+		TLBWI();
+	} else {
+		TLBWR();
+	}
+	setENTRYHI(savedEntryHi);
 }
 
 /**********************************************************
@@ -73,8 +258,9 @@ void initSwapStruct() {
  *
  **********************************************************/
 void uTLB_RefillHandler() {
-	int missingVPN = (((state_PTR)BIOSDATAPAGE)->s_entryHI >> VPN_SHIFT) & VPN_MASK;
-	debugTLBrefill(((state_PTR)BIOSDATAPAGE)->s_entryHI, 0xaa, 0xaa, 0xaa);
+	int missingVPN = (CPU_EXCSTATE->s_entryHI >> VPN_SHIFT) & VPN_MASK;
+	tlbRefills[CPUID()]++;
+	debugTLBrefill(CPU_EXCSTATE->s_entryHI, 0xaa, 0xaa, 0xaa);
 
 	/* Get the Page Table entry for page number p for the Current Process. This will be located in the Current Process’s Page Table*/
 	int missingVPN_idx_in_pgTable = missingVPN % PAGE_TABLE_SIZE;
@@ -82,19 +268,75 @@ void uTLB_RefillHandler() {
 	support_t *currentSupport = currentP->p_supportStruct;
 	pte_t *pte = &(currentSupport->sup_privatePgTbl[missingVPN_idx_in_pgTable]);
 
+	/* a page refilled while resident is in use: give it a second chance*/
+	if((pte->EntryLo & VBITON) == VBITON) {
+		swapPoolTable[helper_frame_index(pte->EntryLo)].referenced = TRUE;
+	}
+
 	/* Write this Page Table entry into the TLB*/
 	setENTRYHI(pte->EntryHi);
 	setENTRYLO(pte->EntryLo);
 	TLBWR();
 
-	LDST((state_PTR)BIOSDATAPAGE);
+	LDST(CPU_EXCSTATE);
+}
+
+/**********************************************************
+ *  helper_mark_dirty
+ *
+ *  Handles a TLB-Modification exception: the first write to
+ *  a page mapped read-only. Sets the D bit of the page, so
+ *  the frame is written back when evicted, refreshes the TLB
+ *  and returns to the U-proc, which retries the write. If the
+ *  page was evicted in the meantime the retry page faults.
+ *
+ *  Parameters:
+ *         support_t *currentSupport – support struct of the U-proc
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_mark_dirty(support_t *currentSupport) {
+	int pageVPN = (currentSupport->sup_exceptState[PGFAULTEXCEPT].s_entryHI >> VPN_SHIFT) & VPN_MASK;
+	pte_t *pte;
+	if(pageVPN == UPROC_STACK_VPN) {
+		pte = &(currentSupport->sup_privatePgTbl[PAGE_TABLE_SIZE - 1]);
+	} else {
+		pte = &(currentSupport->sup_privatePgTbl[pageVPN - STARTVPN]);
+	}
+
+#if NCPU > 1
+	/* a Pager on another processor may be evicting the page right now */
+	SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
+#endif
+	/* disable interrupts, the D bit and the TLB are updated together */
+	setSTATUS(getSTATUS() & (~IECBITON));
+	if((pte->EntryLo & VBITON) == VBITON) {
+		pte->EntryLo |= DBITON;
+		pageDirtied++;
+		helper_tlb_write(pte);
+	}
+	setSTATUS(getSTATUS() | IECBITON);
+#if NCPU > 1
+	SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+#endif
+
+	/* Return control to the Current Process to retry the write */
+	LDST((state_PTR) & (currentSupport->sup_exceptState[PGFAULTEXCEPT]));
 }
 
 /**********************************************************
  *  page_replace
  *
- *  Selects a free or replaceable frame from the swap pool
- *  using a simple FIFO algorithm.
+ *  Selects a free or replaceable frame from the swap pool.
+ *  A free frame is used first. Otherwise the frame under the
+ *  hand is taken: with REPLACE_FIFO right away, with REPLACE_CLOCK
+ *  after skipping, and clearing the reference bit of, every
+ *  referenced frame and dropping its page from the TLB. A full
+ *  turn clears every bit, so the hand always stops. Frames in
+ *  transit (being evicted or filled) and pinned frames are
+ *  always skipped.
+ *  Called with the Swap Pool table held.
  *
  *  Parameters:
  *
@@ -103,26 +345,45 @@ void uTLB_RefillHandler() {
  *         int – index of the selected swap pool frame
  **********************************************************/
 int page_replace() {
-	static int nextFrame = 0;
-
 	/* Look for an empty frame */
 	int pickedFrame;
 	for(pickedFrame = 0; pickedFrame < SWAP_POOL_SIZE; pickedFrame = pickedFrame + 1) {
-		if(swapPoolTable[pickedFrame].ASID == -1) {
+		if(swapPoolTable[pickedFrame].state == FRAME_FREE) {
 			/* so that frame i doesn't get replace right away next time but only after circulated */
-			if(pickedFrame == nextFrame) {
-				nextFrame = (nextFrame + 1) % SWAP_POOL_SIZE;
+			if(pickedFrame == clockHand) {
+				clockHand = (clockHand + 1) % SWAP_POOL_SIZE;
 			}
 			return pickedFrame;
 		}
 	}
 
-	/* If no free frame, select the oldest one (FIFO) */
-	int selectedFrame = nextFrame;
-	/* Move to next in circular order */
-	nextFrame = (nextFrame + 1) % (SWAP_POOL_SIZE);
+	/* If no free frame, move the hand to the oldest frame not in transit. At most one frame per
+	   U-proc in transit, or two pinned by its device SYSCALL, plus the one of the page cleaner, is
+	   unavailable, so the hand stops within a turn
+	   (two with REPLACE_CLOCK). */
+	while(TRUE) {
+		int selectedFrame = clockHand;
+		/* Move to next in circular order */
+		clockHand = (clockHand + 1) % (SWAP_POOL_SIZE);
 
-	return selectedFrame;
+		if(swapPoolTable[selectedFrame].state != FRAME_INUSE || swapPoolTable[selectedFrame].pinned > 0) {
+			continue;
+		}
+#if PAGE_REPLACE_POLICY == REPLACE_CLOCK
+		/* second chance for every frame referenced since the hand last passed */
+		if(swapPoolTable[selectedFrame].referenced) {
+			swapPoolTable[selectedFrame].referenced = FALSE;
+			/* the next access to the page refills the TLB and sets the bit again */
+			setSTATUS(getSTATUS() & (~IECBITON));
+			helper_tlb_drop(swapPoolTable[selectedFrame].matchingPgTableEntry->EntryHi);
+			helper_tlb_shootdown();
+			setSTATUS(getSTATUS() | IECBITON);
+			pageSecondChances++;
+			continue;
+		}
+#endif
+		return selectedFrame;
+	}
 }
 
 /**********************************************************
@@ -175,7 +436,14 @@ void read_write_flash(int pickedSwapPoolFrame, support_t *currentSupport, int bl
 	SYSCALL(VERHO, &(mutex[flashSemIdx]), 0, 0);
 
 	if(flashStatus != READY) {
-		program_trap_handler(currentSupport, &swapPoolSema4);
+		/* the frame was being filled for the U-proc: give it back before the U-proc goes */
+		SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
+		swapPoolTable[pickedSwapPoolFrame].state = FRAME_FREE;
+		swapPoolTable[pickedSwapPoolFrame].ASID = -1;
+		swapPoolTable[pickedSwapPoolFrame].VPN = -1;
+		swapPoolTable[pickedSwapPoolFrame].matchingPgTableEntry = NULL;
+		SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+		program_trap_handler(currentSupport, NULL);
 	}
 }
 
@@ -189,87 +457,285 @@ HIDDEN void helper_copy_block(int *src, int *dst){
     }
 }
 
-void write_to_disk_for_pager(int devNo, int sectNo2D, int src, support_t *currentSupport){
-    int disk_sem_idx = devSemIdx(DISKINT, devNo, FALSE);
-
-    device_t *disk_dev_reg_addr = devAddrBase(DISKINT, devNo);
-
-    int maxcyl = ((disk_dev_reg_addr->d_data1) >> 16) & 0xFFFF;
-    int maxhead = ((disk_dev_reg_addr->d_data1) >> 8) & 0xFF;
-    int maxsect = (disk_dev_reg_addr->d_data1) & 0xFF;
+/**********************************************************
+ *  write_to_disk_for_pager
+ *
+ *  Writes a frame to a block of the swap disk.
+ *
+ *  Parameters:
+ *         int devNo – disk device number
+ *         int sectNo2D – linear block number
+ *         int src – address of the frame
+ *         support_t *currentSupport – U-proc killed on a bad block
+ *
+ *  Returns:
+ *         int – READY, or the negated device status on error
+ **********************************************************/
+int write_to_disk_for_pager(int devNo, int sectNo2D, int src, support_t *currentSupport){
+    int maxcyl = diskState[devNo].dk_maxcyl;
+    int maxhead = diskState[devNo].dk_maxhead;
+    int maxsect = diskState[devNo].dk_maxsect;
 
 	debugCheckDskDimension(maxcyl, maxhead, maxsect, 0xbb);
 
-    if (sectNo2D > (maxcyl*maxhead*maxsect)){
+    if (sectNo2D >= (maxcyl*maxhead*maxsect)){
         program_trap_handler(currentSupport, NULL);
     }
 
-    SYSCALL(PASSERN, &(mutex[disk_sem_idx]), 0, 0);
-        int sectNo = (sectNo2D % (maxhead * maxsect)) % maxsect;
-		int headNo = (sectNo2D % (maxhead * maxsect)) / maxsect; /*divide and round down*/
-    	int cylNo = sectNo2D / (maxhead * maxsect);
-		debugCheckDskDimension(sectNo, headNo, cylNo, sectNo2D);
-        setSTATUS(getSTATUS() & (~IECBITON));
-            disk_dev_reg_addr->d_command = (cylNo << CYLNUM_SHIFT) + SEEKCYL; /*seek*/
-            int disk_status = SYSCALL(IOWAIT, DISKINT, devNo, 0);
-        setSTATUS(getSTATUS() | IECBITON);
-        if (disk_status != READY){
-            SYSCALL(VERHO, &(mutex[disk_sem_idx]), 0, 0);
-            return 0 - disk_status;
-        }
-        disk_dev_reg_addr->d_data0 = src;
-        setSTATUS(getSTATUS() & (~IECBITON));
-            disk_dev_reg_addr->d_command = (headNo << HEADNUM_SHIFT) + (sectNo << SECTNUM_SHIFT) + WRITEBLK_DSK; /*write*/
-            disk_status = SYSCALL(IOWAIT, DISKINT, devNo, 0);
-        setSTATUS(getSTATUS() | IECBITON);
-    SYSCALL(VERHO, &(mutex[disk_sem_idx]), 0, 0);
-
-    if (disk_status == READY){
-        return disk_status;
-    } else {
-        return 0 - disk_status;
+    int sectNo = (sectNo2D % (maxhead * maxsect)) % maxsect;
+	int headNo = (sectNo2D % (maxhead * maxsect)) / maxsect; /*divide and round down*/
+    int cylNo = sectNo2D / (maxhead * maxsect);
+	debugCheckDskDimension(sectNo, headNo, cylNo, sectNo2D);
+
+    return disk_request(devNo, cylNo, headNo, sectNo, src, TRUE);
+}
+
+/**********************************************************
+ *  read_from_disk_for_pager
+ *
+ *  Reads a block of the swap disk into a frame.
+ *
+ *  Parameters:
+ *         int devNo – disk device number
+ *         int sectNo2D – linear block number
+ *         int dst – address of the frame
+ *         support_t *currentSupport – U-proc killed on a bad block
+ *
+ *  Returns:
+ *         int – READY, or the negated device status on error
+ **********************************************************/
+HIDDEN int read_from_disk_for_pager(int devNo, int sectNo2D, int dst, support_t *currentSupport){
+    int maxcyl = diskState[devNo].dk_maxcyl;
+    int maxhead = diskState[devNo].dk_maxhead;
+    int maxsect = diskState[devNo].dk_maxsect;
+
+    if (sectNo2D >= (maxcyl*maxhead*maxsect)){
+        program_trap_handler(currentSupport, NULL);
     }
+
+    int sectNo = (sectNo2D % (maxhead * maxsect)) % maxsect;
+	int headNo = (sectNo2D % (maxhead * maxsect)) / maxsect; /*divide and round down*/
+    int cylNo = sectNo2D / (maxhead*maxsect);
+
+    return disk_request(devNo, cylNo, headNo, sectNo, dst, FALSE);
 }
 
-HIDDEN void read_from_disk_for_pager(int devNo, int sectNo2D, int dst, support_t *currentSupport){
-	int disk_sem_idx = devSemIdx(DISKINT, devNo, FALSE);
 
-    device_t *disk_dev_reg_addr = devAddrBase(DISKINT, devNo);
+/**********************************************************
+ *  helper_find_evicting
+ *
+ *  Looks for a page whose frame is still being written back
+ *  to the swap disk. Called with the Swap Pool table held.
+ *
+ *  Parameters:
+ *         int asid – owner of the page
+ *         int vpn – page number of the page
+ *
+ *  Returns:
+ *         int – index of the frame, or NOFRAME
+ **********************************************************/
+HIDDEN int helper_find_evicting(int asid, int vpn) {
+	int i;
+	for(i = 0; i < SWAP_POOL_SIZE; i++) {
+		if(swapPoolTable[i].state == FRAME_EVICTING && swapPoolTable[i].ASID == asid && swapPoolTable[i].VPN == vpn) {
+			return i;
+		}
+	}
+	return NOFRAME;
+}
 
-    int maxcyl = ((disk_dev_reg_addr->d_data1) >> 16) & 0xFFFF;
-    int maxhead = ((disk_dev_reg_addr->d_data1) >> 8) & 0xFF;
-    int maxsect = (disk_dev_reg_addr->d_data1) & 0xFF;
+/**********************************************************
+ *  helper_wait_frame
+ *
+ *  Releases the Swap Pool table and blocks on the wait queue
+ *  of a frame until its transfer ends. Returns without the
+ *  Swap Pool table.
+ *
+ *  Parameters:
+ *         int frame – index of the frame in transit
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_wait_frame(int frame) {
+	swapPoolTable[frame].waiters++;
+	SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+	SYSCALL(PASSERN, &(swapPoolTable[frame].waitSem), 0, 0);
+}
 
-    if (sectNo2D > (maxcyl*maxhead*maxsect)){
-        program_trap_handler(currentSupport, NULL);
-    }
+/**********************************************************
+ *  helper_wake_frame
+ *
+ *  Wakes every U-proc waiting for the transfer of a frame to
+ *  end. Called with the Swap Pool table held.
+ *
+ *  Parameters:
+ *         int frame – index of the frame
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_wake_frame(int frame) {
+	while(swapPoolTable[frame].waiters > 0) {
+		swapPoolTable[frame].waiters--;
+		SYSCALL(VERHO, &(swapPoolTable[frame].waitSem), 0, 0);
+	}
+}
 
-    SYSCALL(PASSERN, &(mutex[disk_sem_idx]), 0, 0);
-        int sectNo = (sectNo2D % (maxhead * maxsect)) % maxsect;
-		int headNo = (sectNo2D % (maxhead * maxsect)) / maxsect; /*divide and round down*/
-    	int cylNo = sectNo2D / (maxhead*maxsect);
-        setSTATUS(getSTATUS() & (~IECBITON));
-            disk_dev_reg_addr->d_command = (cylNo << CYLNUM_SHIFT) + SEEKCYL;
-            int disk_status = SYSCALL(IOWAIT, DISKINT, devNo, 0);
-        setSTATUS(getSTATUS() | IECBITON);
-        if (disk_status != READY){
-            SYSCALL(VERHO, &(mutex[disk_sem_idx]), 0, 0);
-            return 0 - disk_status;
-        }
-        disk_dev_reg_addr->d_data0 = dst;
-        setSTATUS(getSTATUS() & (~IECBITON));
-            disk_dev_reg_addr->d_command = (headNo << HEADNUM_SHIFT) + (sectNo << SECTNUM_SHIFT) + READBLK_DSK;
-            disk_status = SYSCALL(IOWAIT, DISKINT, devNo, 0);
-        setSTATUS(getSTATUS() | IECBITON);
-    SYSCALL(VERHO, &(mutex[disk_sem_idx]), 0, 0);
-
-    if (disk_status == READY){
-        return disk_status;
-    } else{
-        return 0 - disk_status;
-    }
+/**********************************************************
+ *  helper_free_frame
+ *
+ *  Gives a frame back to the swap pool. Called with the Swap
+ *  Pool table held.
+ *
+ *  Parameters:
+ *         int frame – index of the frame
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_free_frame(int frame) {
+	swapPoolTable[frame].state = FRAME_FREE;
+	swapPoolTable[frame].ASID = -1;
+	swapPoolTable[frame].VPN = -1;
+	swapPoolTable[frame].matchingPgTableEntry = NULL;
+	swapPoolTable[frame].referenced = FALSE;
+}
+
+/**********************************************************
+ *  helper_fill_frame
+ *
+ *  Gives a frame to the page being brought in, marking it as
+ *  being filled. Called with the Swap Pool table held.
+ *
+ *  Parameters:
+ *         int frame – index of the frame
+ *         support_t *currentSupport – support struct of the new owner
+ *         int vpn – page number of the page brought in
+ *         pte_t *pte – Page Table entry of the page
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_fill_frame(int frame, support_t *currentSupport, int vpn, pte_t *pte) {
+	swapPoolTable[frame].ASID = currentSupport->sup_asid;
+	swapPoolTable[frame].VPN = vpn;
+	swapPoolTable[frame].matchingPgTableEntry = pte;
+	swapPoolTable[frame].state = FRAME_FILLING;
+}
+
+/**********************************************************
+ *  helper_page_index
+ *
+ *  Computes the Page Table index of a page, which is also its
+ *  block on the flash of the U-proc.
+ *
+ *  Parameters:
+ *         int vpn – page number of the page
+ *
+ *  Returns:
+ *         int – Page Table index
+ **********************************************************/
+HIDDEN int helper_page_index(int vpn) {
+	if(vpn == UPROC_STACK_VPN) {
+		return PAGE_TABLE_SIZE - 1;
+	}
+	return vpn - STARTVPN;
+}
+
+/**********************************************************
+ *  helper_page_block
+ *
+ *  Computes the block of the swap disk holding a page.
+ *
+ *  Parameters:
+ *         int asid – owner of the page
+ *         int vpn – page number of the page
+ *
+ *  Returns:
+ *         int – block number on the swap disk
+ **********************************************************/
+HIDDEN int helper_page_block(int asid, int vpn) {
+	return PAGE_TABLE_SIZE * (asid - 1) + helper_page_index(vpn);
+}
+
+/**********************************************************
+ *  helper_page_written_back
+ *
+ *  Records that the swap disk copy of a page is the current
+ *  one. Called with the Swap Pool table held, once the
+ *  write-back returned READY: a failed write leaves the page
+ *  to be read from where it was before.
+ *
+ *  Parameters:
+ *         int asid – owner of the page
+ *         int vpn – page number of the page
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_page_written_back(int asid, int vpn) {
+	pagesOnDisk[asid] |= (1 << helper_page_index(vpn));
+}
+
+/**********************************************************
+ *  mark_backing_store_copied
+ *
+ *  Records that every page of a U-proc was copied from its
+ *  flash to the swap disk. Used by the eager set up of the
+ *  backing store, before the swap pool is in use.
+ *
+ *  Parameters:
+ *         int asid – owner of the pages
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void mark_backing_store_copied(int asid) {
+	pagesOnDisk[asid] = 0xFFFFFFFF;
 }
 
+/**********************************************************
+ *  helper_free_frames
+ *
+ *  Counts the free frames of the swap pool. Called with the
+ *  Swap Pool table held.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *         int – number of FRAME_FREE frames
+ **********************************************************/
+HIDDEN int helper_free_frames() {
+	int freeFrames = 0;
+	int i;
+	for(i = 0; i < SWAP_POOL_SIZE; i++) {
+		if(swapPoolTable[i].state == FRAME_FREE) {
+			freeFrames++;
+		}
+	}
+	return freeFrames;
+}
+
+/**********************************************************
+ *  helper_wake_cleaner
+ *
+ *  Wakes the page cleaner if it sleeps while free frames are
+ *  running low. Called with the Swap Pool table held.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_wake_cleaner() {
+	if(cleanerAsleep && helper_free_frames() < CLEANER_LOW_FRAMES) {
+		cleanerAsleep = FALSE;
+		SYSCALL(VERHO, &cleanerSem, 0, 0);
+	}
+}
 
 /**********************************************************
  *  TLB_exception_handler
@@ -277,6 +743,14 @@ HIDDEN void read_from_disk_for_pager(int devNo, int sectNo2D, int dst, support_t
  *  Handles page faults by loading the missing page into memory.
  *  Kicks out a page if memory is full and update page tables and TLB.
  *
+ *  The Swap Pool table is only held to pick a frame and update
+ *  its entry, never across disk I/O. A frame being written back
+ *  is FRAME_EVICTING (its entry still names the evicted page),
+ *  a frame being read into is FRAME_FILLING; page_replace skips
+ *  both. A U-proc faulting on its own page while that page is
+ *  still being written back waits on the wait queue of the frame,
+ *  since the swap disk copy is not current yet.
+ *
  *  Parameters:
  *
  *
@@ -290,14 +764,11 @@ void TLB_exception_handler() {
 	/* Determine the cause of the TLB exception. )*/
 	int TLBcause = CauseExcCode(currentSupport->sup_exceptState[PGFAULTEXCEPT].s_cause);
 
-	/* If the Cause is a TLB-Modification exception, treat this exception as a program trap */
+	/* If the Cause is a TLB-Modification exception, the page is written for the first time */
 	if(TLBcause == TLB_MOD) {
-		program_trap_handler(currentSupport, NULL);
+		helper_mark_dirty(currentSupport);
 	}
 
-	/* Gain mutual exclusion over the Swap Pool table. */
-	SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
-
 	/* Determine the missing page number which is found in the saved exception state’s EntryHi */
 	int missingVPN = (currentSupport->sup_exceptState[PGFAULTEXCEPT].s_entryHI >> VPN_SHIFT) & VPN_MASK;
 
@@ -308,66 +779,378 @@ void TLB_exception_handler() {
 	} else {
 		pgTableIndex = (missingVPN - STARTVPN);
 	}
+	pte_t *missingPte = &(currentSupport->sup_privatePgTbl[pgTableIndex]);
+
+	/* Gain mutual exclusion over the Swap Pool table. */
+	SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
+	pageFaults++;
+
+	/* A page still being written back must reach the swap disk before it is read again. */
+	int pickedFrame = helper_find_evicting(currentSupport->sup_asid, missingVPN);
+	while(pickedFrame != NOFRAME) {
+		helper_wait_frame(pickedFrame);
+		SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
+		pickedFrame = helper_find_evicting(currentSupport->sup_asid, missingVPN);
+	}
+
+	/* The page is present, only a stale TLB entry faulted: refresh it. */
+	if((missingPte->EntryLo & VBITON) == VBITON) {
+		setSTATUS(getSTATUS() & (~IECBITON));
+		helper_tlb_write(missingPte);
+		setSTATUS(getSTATUS() | IECBITON);
+		SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+		LDST((state_PTR) & (currentSupport->sup_exceptState[PGFAULTEXCEPT]));
+	}
 
 	/* Pick a frame, i, from the Swap Pool.*/
-	int pickedFrame = page_replace();
+	pickedFrame = page_replace();
 
 	/* Determine if frame i is occupied; examine entry i in the Swap Pool table. */
-	if((swapPoolTable[pickedFrame].ASID != -1)) {
+	int victimDirty = FALSE;
+	int victimBlock;
+	if(swapPoolTable[pickedFrame].state == FRAME_INUSE) {
+		pageEvictions++;
 		/* disable interrupts */
 		setSTATUS(getSTATUS() & (~IECBITON));
 		/* Update process x’s Page Table: mark Page Table entry k as not valid.
 		This entry is easily accessible, since the Swap Pool table’s entry i contains a pointer to this Page Table entry. */
 		pte_t *occupiedPgTable = swapPoolTable[pickedFrame].matchingPgTableEntry;
 
-		occupiedPgTable->EntryLo = (DBITON & GBITOFF) & VBITOFF;
-		/* Update the TLB, if needed. */
-		TLBCLR();
-		int write_out_pg_tbl;
-		if(swapPoolTable[pickedFrame].VPN == UPROC_STACK_VPN) {
-			write_out_pg_tbl = PAGE_TABLE_SIZE - 1;
-		} else {
-			write_out_pg_tbl = (swapPoolTable[pickedFrame].VPN - STARTVPN);
-		}
+		/* the D bit is only set once the page was written since it was brought in */
+		victimDirty = ((occupiedPgTable->EntryLo & DBITON) == DBITON);
+		occupiedPgTable->EntryLo = ALLOFF;
+		/* Update the TLB, if needed: only the slot of the evicted page. */
+		helper_tlb_drop(occupiedPgTable->EntryHi);
+		helper_tlb_shootdown();
 		/* enable interrupts */
 		setSTATUS(getSTATUS() | IECBITON);
-		/* Update process x’s backing store.
-		Treat any error status from the write operation as a program trap.*/
-		if((occupiedPgTable->EntryLo & DBITON) == DBITON) { /* D bit set */
 
-			/* isRead = 0 since we are writing */
-			/* read_write_flash(pickedFrame, currentSupport, write_out_pg_tbl, FALSE); */
-			write_to_disk_for_pager(RESERVED_DISK_NO, 32*(swapPoolTable[pickedFrame].ASID - 1) + write_out_pg_tbl, SWAP_POOL_START + (pickedFrame * PAGESIZE), currentSupport);
+		if(victimDirty) {
+			/* the entry keeps naming the evicted page until it is on the swap disk */
+			victimBlock = helper_page_block(swapPoolTable[pickedFrame].ASID, swapPoolTable[pickedFrame].VPN);
+			swapPoolTable[pickedFrame].state = FRAME_EVICTING;
+		} else {
+			/* clean page: the copy on the swap disk is still up to date */
+			pageWritesAvoided++;
 		}
 	}
+	if(!victimDirty) {
+		helper_fill_frame(pickedFrame, currentSupport, missingVPN, missingPte);
+	}
+
+	helper_wake_cleaner();
 
-	/* Read the contents of the Current Process’s backingstore/flash device logical page p into frame i. */
-	/* isRead = 1 since we are reading */
-	/* read_write_flash(pickedFrame, currentSupport, pgTableIndex, TRUE);*/
-	read_from_disk_for_pager(RESERVED_DISK_NO, 32*(currentSupport->sup_asid - 1) + pgTableIndex, SWAP_POOL_START + (pickedFrame * PAGESIZE), currentSupport);
+	/* Release mutual exclusion over the Swap Pool table during the I/O. */
+	SYSCALL(VERHO, &swapPoolSema4, 0, 0);
 
-	/* Update the Swap Pool table’s entry i to reflect frame i’s new contents: page p belonging to the Current Process’s ASID,
-	and a pointer to the Current Process’s Page Table entry for page p. */
-	swapPoolTable[pickedFrame].ASID = currentSupport->sup_asid;
-	swapPoolTable[pickedFrame].VPN = missingVPN;
-	swapPoolTable[pickedFrame].matchingPgTableEntry = &(currentSupport->sup_privatePgTbl[pgTableIndex]);
+	if(victimDirty) {
+		/* Update process x’s backing store. */
+		int writeStatus = write_to_disk_for_pager(RESERVED_DISK_NO, victimBlock, SWAP_POOL_START + (pickedFrame * PAGESIZE), currentSupport);
 
+		SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
+		if(writeStatus != READY) {
+			/* the frame still holds the only current copy: map it back for its owner, the swap disk failed the faulting U-proc */
+			if(swapPoolTable[pickedFrame].ASID == -1) {
+				helper_free_frame(pickedFrame);
+			} else {
+				swapPoolTable[pickedFrame].matchingPgTableEntry->EntryLo = (SWAP_POOL_START + (pickedFrame * PAGESIZE)) | VBITON | DBITON;
+				swapPoolTable[pickedFrame].state = FRAME_INUSE;
+			}
+			helper_wake_frame(pickedFrame);
+			program_trap_handler(currentSupport, &swapPoolSema4);
+		}
+		/* the evicted page is safe: the frame is ours, wake its owner if it faulted on it meanwhile */
+		if(swapPoolTable[pickedFrame].ASID != -1) {
+			helper_page_written_back(swapPoolTable[pickedFrame].ASID, swapPoolTable[pickedFrame].VPN);
+		}
+		helper_fill_frame(pickedFrame, currentSupport, missingVPN, missingPte);
+		helper_wake_frame(pickedFrame);
+		SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+	}
+
+	/* Read the contents of the Current Process’s backingstore logical page p into frame i:
+	   from the swap disk once the page was written back, from the flash before. */
+	if((pagesOnDisk[currentSupport->sup_asid] & (1 << pgTableIndex)) != 0) {
+		if(read_from_disk_for_pager(RESERVED_DISK_NO, helper_page_block(currentSupport->sup_asid, missingVPN), SWAP_POOL_START + (pickedFrame * PAGESIZE), currentSupport) != READY) {
+			/* the frame was being filled for the U-proc: give it back before the U-proc goes */
+			SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
+			helper_free_frame(pickedFrame);
+			program_trap_handler(currentSupport, &swapPoolSema4);
+		}
+	} else {
+		read_write_flash(pickedFrame, currentSupport, pgTableIndex, TRUE);
+		pagesFromFlash++;
+	}
+
+	SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
 	setSTATUS(getSTATUS() & (~IECBITON));
 	/* Update the Current Process’s Page Table entry for page p to indicate it is now present (V bit) and occupying frame i (PFN field).*/
 	/* Set new PFN */
-	swapPoolTable[pickedFrame].matchingPgTableEntry->EntryLo = (SWAP_POOL_START + (pickedFrame * PAGESIZE));
-	/* Set V bit */
-	swapPoolTable[pickedFrame].matchingPgTableEntry->EntryLo |= VBITON;
-	/* Set D bit */
-	swapPoolTable[pickedFrame].matchingPgTableEntry->EntryLo |= DBITON;
-
-	/* Update the TLB. */
-	TLBCLR();
+	missingPte->EntryLo = (SWAP_POOL_START + (pickedFrame * PAGESIZE));
+	/* Set V bit, D bit stays off: the page is read-only until its first write */
+	missingPte->EntryLo |= VBITON;
+
+	/* Update the TLB: write the new translation directly. */
+	helper_tlb_write(missingPte);
 	setSTATUS(getSTATUS() | IECBITON);
 
+	/* the faulting access is a reference */
+	swapPoolTable[pickedFrame].referenced = TRUE;
+	swapPoolTable[pickedFrame].state = FRAME_INUSE;
+	helper_wake_frame(pickedFrame);
+	if(firstUserTOD == 0) {
+		/* the first page-in returns to the first user instruction */
+		STCK(firstUserTOD);
+	}
+
 	/* Release mutual exclusion over the Swap Pool table. SYS4 */
 	SYSCALL(VERHO, &swapPoolSema4, 0, 0);
 
 	/* Return control to the Current Process */
 	LDST((state_PTR) & (currentSupport->sup_exceptState[PGFAULTEXCEPT]));
 }
+
+/**********************************************************
+ *  helper_clean_frame
+ *
+ *  Writes back one dirty page ahead of the clock hand. Its
+ *  D bit is cleared and its TLB entry dropped first, so a write
+ *  during the I/O raises a TLB-Modification exception and marks
+ *  the page dirty again. The page stays mapped meanwhile; the
+ *  frame is FRAME_CLEANING, which page_replace skips.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *         int – TRUE if a page was written back
+ **********************************************************/
+HIDDEN int helper_clean_frame() {
+	int i;
+	int frame = NOFRAME;
+
+	SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
+	for(i = 0; i < CLEANER_LOOKAHEAD && frame == NOFRAME; i++) {
+		int candidate = (clockHand + i) % SWAP_POOL_SIZE;
+		/* a pinned page may be the target of a device read, it must stay dirty */
+		if(swapPoolTable[candidate].state == FRAME_INUSE && swapPoolTable[candidate].pinned == 0 && (swapPoolTable[candidate].matchingPgTableEntry->EntryLo & DBITON) == DBITON) {
+			frame = candidate;
+		}
+	}
+	if(frame == NOFRAME) {
+		SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+		return FALSE;
+	}
+
+	setSTATUS(getSTATUS() & (~IECBITON));
+	pte_t *pte = swapPoolTable[frame].matchingPgTableEntry;
+	pte->EntryLo &= DBITOFF;
+	helper_tlb_drop(pte->EntryHi);
+	helper_tlb_shootdown();
+	setSTATUS(getSTATUS() | IECBITON);
+	int block = helper_page_block(swapPoolTable[frame].ASID, swapPoolTable[frame].VPN);
+	swapPoolTable[frame].state = FRAME_CLEANING;
+	SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+
+	/* block numbers of live pages are always on the disk, no support struct is needed */
+	int writeStatus = write_to_disk_for_pager(RESERVED_DISK_NO, block, SWAP_POOL_START + (frame * PAGESIZE), NULL);
+
+	SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
+	if(swapPoolTable[frame].ASID == -1) {
+		/* the owner terminated during the write-back */
+		helper_free_frame(frame);
+	} else {
+		if(writeStatus != READY) {
+			/* the swap disk copy is stale: the page is dirty again, the Pager writes it back on eviction */
+			pte->EntryLo |= DBITON;
+		} else {
+			helper_page_written_back(swapPoolTable[frame].ASID, swapPoolTable[frame].VPN);
+		}
+		swapPoolTable[frame].state = FRAME_INUSE;
+	}
+	SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+	if(writeStatus != READY) {
+		/* stop the batch, the cleaner sleeps until the Pager wakes it */
+		return FALSE;
+	}
+	pagesCleaned++;
+	return TRUE;
+}
+
+/**********************************************************
+ *  page_cleaner
+ *
+ *  Body of the page cleaner. While free frames are low it
+ *  writes back the dirty pages ahead of the clock hand. Once
+ *  enough frames are free, or no dirty page is left ahead of
+ *  the hand, it sleeps until the Pager, short of frames on a
+ *  later fault, wakes it. It never polls the pseudo-clock.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void page_cleaner() {
+	int i;
+	int cleaned = FALSE;
+	while(TRUE) {
+		SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
+		if(!cleaned || helper_free_frames() >= CLEANER_LOW_FRAMES) {
+			/* nothing dirty ahead of the hand or enough free frames: sleep until the Pager runs short */
+			cleanerAsleep = TRUE;
+			SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+			SYSCALL(PASSERN, &cleanerSem, 0, 0);
+		} else {
+			SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+		}
+
+		cleaned = TRUE;
+		for(i = 0; i < CLEANER_LOOKAHEAD && cleaned; i++) {
+			cleaned = helper_clean_frame();
+		}
+	}
+}
+
+/**********************************************************
+ *  initPageCleaner
+ *
+ *  Creates the page cleaner, a kernel-mode process with its
+ *  stack in the third frame from the top of RAM.
+ *  Called by test() after initSwapStruct.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void initPageCleaner() {
+	cleanerSem = 0;
+	cleanerAsleep = FALSE;
+	pagesCleaned = 0;
+
+	state_t cleanerState;
+	cleanerState.s_pc = (memaddr)page_cleaner;
+	cleanerState.s_t9 = (memaddr)page_cleaner;
+	cleanerState.s_sp = ((devregarea_t *)RAMBASEADDR)->rambase + ((devregarea_t *)RAMBASEADDR)->ramsize - (2 * PAGESIZE);
+	cleanerState.s_status = (IEPBITON & KUPBITOFF) | IPBITS;
+	cleanerState.s_entryHI = 0 << ASID_SHIFT;
+	SYSCALL(CREATETHREAD, &cleanerState, NULL, 0);
+}
+
+/**********************************************************
+ *  pin_user_page
+ *
+ *  Translates a user address to the RAM address holding it and
+ *  pins the frame of its page until unpin_user_page.
+ *  The page is touched first, so a missing page goes through
+ *  the Pager like any access of the U-proc; when a device
+ *  will write the page the touch is a store, which also marks
+ *  the page dirty. The touch is retried if the page was
+ *  replaced before the Swap Pool table could be taken.
+ *
+ *  Parameters:
+ *         support_t *currentSupport – support struct of the U-proc
+ *         memaddr userAddr – virtual address in the page
+ *         int deviceWrites – TRUE if a device writes the page
+ *
+ *  Returns:
+ *         memaddr – physical address of userAddr
+ **********************************************************/
+memaddr pin_user_page(support_t *currentSupport, memaddr userAddr, int deviceWrites) {
+	volatile int *word = (volatile int *)(userAddr & PFN_MASK);
+	pte_t *pte = &(currentSupport->sup_privatePgTbl[helper_page_index((userAddr >> VPN_SHIFT) & VPN_MASK)]);
+	int frame;
+
+	while(TRUE) {
+		if(deviceWrites) {
+			*word = *word;
+		} else {
+			frame = *word;
+		}
+
+		SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
+		if((pte->EntryLo & VBITON) == VBITON && (!deviceWrites || (pte->EntryLo & DBITON) == DBITON)) {
+			frame = helper_frame_index(pte->EntryLo);
+			swapPoolTable[frame].pinned++;
+			SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+			return (pte->EntryLo & PFN_MASK) + (userAddr & ~PFN_MASK);
+		}
+		SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+	}
+}
+
+/**********************************************************
+ *  unpin_user_page
+ *
+ *  Releases a pin taken by pin_user_page once the transfer is
+ *  over. The page is still present since it was pinned.
+ *
+ *  Parameters:
+ *         support_t *currentSupport – support struct of the U-proc
+ *         memaddr userAddr – virtual address in the page
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void unpin_user_page(support_t *currentSupport, memaddr userAddr) {
+	pte_t *pte = &(currentSupport->sup_privatePgTbl[helper_page_index((userAddr >> VPN_SHIFT) & VPN_MASK)]);
+
+	SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
+	swapPoolTable[helper_frame_index(pte->EntryLo)].pinned--;
+	SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+}
+
+#if VM_SELFTEST
+/**********************************************************
+ *  check_pinned_replace
+ *
+ *  Start up check of the pinning: fills the Swap Pool with
+ *  referenced pages of no U-proc, pins two of them, one under
+ *  the hand, and runs page_replace for two turns of the hand,
+ *  so every frame is passed at least twice. None of the picks
+ *  may be a pinned frame. The Swap Pool table is reset after.
+ *  Called by the instantiator before the U-procs start.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *         TRUE if no pinned frame was picked, FALSE otherwise
+ **********************************************************/
+int check_pinned_replace() {
+	static pte_t fakePte[SWAP_POOL_SIZE];
+	int i;
+	int picked;
+	int ok = TRUE;
+	int pinA = clockHand;
+	int pinB = (clockHand + (SWAP_POOL_SIZE / 2)) % SWAP_POOL_SIZE;
+
+	SYSCALL(PASSERN, &swapPoolSema4, 0, 0);
+	for(i = 0; i < SWAP_POOL_SIZE; i++) {
+		/* ASID 0 is never given to a U-proc, so no TLB entry matches */
+		fakePte[i].EntryHi = (KUSEG + (i << VPN_SHIFT));
+		fakePte[i].EntryLo = (SWAP_POOL_START + (i * PAGESIZE)) | VBITON;
+		swapPoolTable[i].ASID = 0;
+		swapPoolTable[i].VPN = i;
+		swapPoolTable[i].matchingPgTableEntry = &fakePte[i];
+		swapPoolTable[i].referenced = TRUE;
+		swapPoolTable[i].state = FRAME_INUSE;
+	}
+	swapPoolTable[helper_frame_index(fakePte[pinA].EntryLo)].pinned++;
+	swapPoolTable[helper_frame_index(fakePte[pinB].EntryLo)].pinned++;
+
+	for(i = 0; i < 2 * SWAP_POOL_SIZE; i++) {
+		picked = page_replace();
+		if(picked == pinA || picked == pinB) {
+			ok = FALSE;
+		}
+	}
+	SYSCALL(VERHO, &swapPoolSema4, 0, 0);
+
+	initSwapStruct();
+	return ok;
+}
+#endif
@@ -18,9 +18,25 @@
 /* global variables */
 extern swapPoolFrame_t swapPoolTable[SWAP_POOL_SIZE];
 extern int swapPoolSema4;
+extern int pageFaults;
+extern int pageEvictions;
+extern int pageSecondChances;
+extern int pageDirtied;
+extern int pageWritesAvoided;
+extern int tlbRefills[NCPU];
+extern int pagesCleaned;
+extern int pagesFromFlash;
+extern cpu_t firstUserTOD;
 
 void initSwapStruct();
 void uTLB_RefillHandler();
 void TLB_exception_handler();
+void initPageCleaner();
+void mark_backing_store_copied(int asid);
+memaddr pin_user_page(support_t *currentSupport, memaddr userBuf, int deviceWrites);
+void unpin_user_page(support_t *currentSupport, memaddr userAddr);
+#if VM_SELFTEST
+int check_pinned_replace();
+#endif
 
 #endif
\ No newline at end of file
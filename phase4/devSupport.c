@@ -1,5 +1,33 @@
 #include "devSupport.h"
 #include "../h/const.h"
+#include "../phase3/vmSupport.h"
+#include "../h/slab.h"
+
+disk_t diskState[DEVPERINT];
+int cacheHits;         /* GETs served from the block cache */
+int cacheMisses;       /* GETs that went to the device */
+int cachePrefetches;   /* blocks queued for the prefetch daemon */
+int cacheWritesCached; /* PUTs completed in the block cache */
+int cacheWriteBacks;   /* dirty blocks written to their device */
+int cacheWriteErrors;  /* dirty blocks the device failed to write */
+
+HIDDEN int flashBounceSem[DEVPERINT]; /* mutex of the DMA bounce buffer of each flash */
+
+/* write-back block cache, shared by all disks and flashes */
+HIDDEN blkbuf_t blkCache[BLKCACHE_SIZE];
+HIDDEN int blkCacheSize;  /* entries that got a frame */
+HIDDEN int blkCacheLock;  /* mutex of the cache and of the prefetch ring */
+HIDDEN int blkCacheClock; /* LRU stamp source */
+HIDDEN blkbuf_t *prefetchRing[BLKCACHE_SIZE]; /* entries waiting for the prefetch daemon */
+HIDDEN int prefetchHead;
+HIDDEN int prefetchTail;
+HIDDEN int prefetchPending; /* entries in prefetchRing, the prefetch daemon waits here */
+HIDDEN int flushAsleep;     /* TRUE while the flush daemon waits on flushWork */
+HIDDEN int flushWork;       /* the flush daemon waits here for a dirty block */
+/* negated status of a write-back that failed, returned by the next PUT or GET to the disk ([0]) or flash ([1]) */
+HIDDEN int blkDevError[2][DEVPERINT];
+/* last block read by each U-proc from each disk ([0]) and flash ([1]) */
+HIDDEN int seqLast[2][DEVPERINT][UPROC_NUM + 1];
 
 HIDDEN void helper_copy_block(int *src, int *dst){
     int i;
@@ -10,144 +38,1009 @@ HIDDEN void helper_copy_block(int *src, int *dst){
     }
 }
 
-void WRITE_TO_DISK(support_t *currentSupport){
-    state_PTR saved_gen_exc_state = &(currentSupport->sup_exceptState[GENERALEXCEPT]);
+/**********************************************************
+ *  initDiskState
+ *
+ *  Reads the geometry of every installed disk once, from
+ *  its DATA1 register. The arm position is unknown until the
+ *  first seek. Called by test() before any disk access.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void initDiskState(){
+    int devNo;
+    int installed = ((devregarea_t *)RAMBASEADDR)->inst_dev[0]; /* disks are the first device line */
+    for (devNo = 0; devNo < DEVPERINT; devNo++){
+        device_t *disk_dev_reg_addr = devAddrBase(DISKINT, devNo);
+        diskState[devNo].dk_maxcyl = 0;
+        diskState[devNo].dk_maxhead = 0;
+        diskState[devNo].dk_maxsect = 0;
+        if ((installed & (1 << devNo)) != 0){
+            diskState[devNo].dk_maxcyl = ((disk_dev_reg_addr->d_data1) >> 16) & 0xFFFF;
+            diskState[devNo].dk_maxhead = ((disk_dev_reg_addr->d_data1) >> 8) & 0xFF;
+            diskState[devNo].dk_maxsect = (disk_dev_reg_addr->d_data1) & 0xFF;
+        }
+        diskState[devNo].dk_cyl = NOCYL;
+        diskState[devNo].dk_seeks = 0;
+        diskState[devNo].dk_seeksSkipped = 0;
+        diskState[devNo].dk_queue = NULL;
+        diskState[devNo].dk_queueLock = 1;
+        diskState[devNo].dk_pending = 0;
+        diskState[devNo].dk_bounceSem = 1;
+        flashBounceSem[devNo] = 1;
+    }
+}
 
-    int devNo = saved_gen_exc_state->s_a2;
-    int disk_sem_idx = devSemIdx(DISKINT, devNo, FALSE);
+/**********************************************************
+ *  disk_seek
+ *
+ *  Moves the arm of a disk to a cylinder. The SEEKCYL command,
+ *  and its interrupt, is skipped when the arm already sits on
+ *  the cylinder. The caller holds the mutex of the disk, which
+ *  every command to the disk goes through.
+ *
+ *  Parameters:
+ *         int devNo – disk device number
+ *         int cylNo – cylinder to reach
+ *
+ *  Returns:
+ *         int – device status of the seek, READY if skipped
+ **********************************************************/
+int disk_seek(int devNo, int cylNo){
+    disk_t *disk = &diskState[devNo];
+    if (disk->dk_cyl == cylNo){
+        disk->dk_seeksSkipped++;
+        return READY;
+    }
 
     device_t *disk_dev_reg_addr = devAddrBase(DISKINT, devNo);
+    setSTATUS(getSTATUS() & (~IECBITON));
+        disk_dev_reg_addr->d_command = (cylNo << CYLNUM_SHIFT) + SEEKCYL; /*seek*/
+        int disk_status = SYSCALL(IOWAIT, DISKINT, devNo, 0);
+    setSTATUS(getSTATUS() | IECBITON);
+    disk->dk_seeks++;
 
-    int maxcyl = ((disk_dev_reg_addr->d_data1) >> 16) & 0xFFFF;
-    int maxhead = ((disk_dev_reg_addr->d_data1) >> 8) & 0xFF;
-    int maxsect = (disk_dev_reg_addr->d_data1) & 0xFF;
+    if (disk_status == READY){
+        disk->dk_cyl = cylNo;
+    } else {
+        disk->dk_cyl = NOCYL;
+    }
+    return disk_status;
+}
 
-    if ((saved_gen_exc_state->s_a1 < KUSEG) || (saved_gen_exc_state->s_a3 > (maxcyl*maxhead*maxsect))){         /*when setting up backing store as disk, depending on where on disk storing an image, it should be illegal to write there too*/
-        program_trap_handler(currentSupport, NULL);
+/**********************************************************
+ *  helper_clook_next
+ *
+ *  Unlinks the next request to serve from the queue of a disk,
+ *  in C-LOOK order: the lowest cylinder at or above the arm,
+ *  or, when none is left above it, the lowest cylinder of the
+ *  queue, so the arm sweeps upward and jumps back once.
+ *  Requests on the same cylinder are served in arrival order.
+ *  Called with the queue lock of the disk held.
+ *
+ *  Parameters:
+ *         disk_t *disk – state of the disk
+ *
+ *  Returns:
+ *         diskreq_t * – request to serve
+ **********************************************************/
+HIDDEN diskreq_t *helper_clook_next(disk_t *disk){
+    diskreq_t *req;
+    diskreq_t *above = NULL;
+    diskreq_t *lowest = NULL;
+    int arm = disk->dk_cyl;
+    if (arm == NOCYL){
+        arm = 0;
     }
 
-    SYSCALL(PASSERN, &(mutex[disk_sem_idx]), 0, 0);
-        int sectNo = (saved_gen_exc_state->s_a3) % maxsect;
-	    int headNo = ((int) ((saved_gen_exc_state->s_a3) / (maxsect * maxcyl))) % maxhead; /*divide and round down*/
-        int cylNo = ((int) ((saved_gen_exc_state->s_a3) / maxsect)) % maxcyl;
-        setSTATUS(getSTATUS() & (~IECBITON));
-            disk_dev_reg_addr->d_command = (cylNo << CYLNUM_SHIFT) + SEEKCYL; /*seek*/
-            int disk_status = SYSCALL(IOWAIT, DISKINT, devNo, 0);
-        setSTATUS(getSTATUS() | IECBITON);
-        if (disk_status != READY){
-            saved_gen_exc_state->s_v0 = 0 - disk_status;
-            SYSCALL(VERHO, &(mutex[disk_sem_idx]), 0, 0);
-            return;
+    for (req = disk->dk_queue; req != NULL; req = req->dr_next){
+        if (req->dr_cyl >= arm && (above == NULL || req->dr_cyl < above->dr_cyl)){
+            above = req;
         }
-        helper_copy_block(saved_gen_exc_state->s_a1, DISK_DMA_BUFFER_BASE_ADDR + (BLOCKSIZE*devNo));
-        disk_dev_reg_addr->d_data0 = DISK_DMA_BUFFER_BASE_ADDR + (BLOCKSIZE*devNo); /*carefull not to do anything with device between writing to data0 and command*/
-        setSTATUS(getSTATUS() & (~IECBITON));
-            disk_dev_reg_addr->d_command = (headNo << HEADNUM_SHIFT) + (sectNo << SECTNUM_SHIFT) + WRITEBLK_DSK; /*write*/
-            disk_status = SYSCALL(IOWAIT, DISKINT, devNo, 0);
-        setSTATUS(getSTATUS() | IECBITON);
-    SYSCALL(VERHO, &(mutex[disk_sem_idx]), 0, 0);
+        if (lowest == NULL || req->dr_cyl < lowest->dr_cyl){
+            lowest = req;
+        }
+    }
+    if (above == NULL){
+        above = lowest;
+    }
 
-    if (disk_status == READY){
-        saved_gen_exc_state->s_v0 = disk_status;
+    /* unlink it */
+    if (disk->dk_queue == above){
+        disk->dk_queue = above->dr_next;
     } else {
-        saved_gen_exc_state->s_v0 = 0 - disk_status;
+        for (req = disk->dk_queue; req->dr_next != above; req = req->dr_next){
+        }
+        req->dr_next = above->dr_next;
     }
+    return above;
 }
 
-void READ_FROM_DISK(support_t *currentSupport){
-    state_PTR saved_gen_exc_state = &(currentSupport->sup_exceptState[GENERALEXCEPT]);
-
-    int devNo = saved_gen_exc_state->s_a2;
+/**********************************************************
+ *  disk_dispatcher
+ *
+ *  Body of the kernel-mode process owning a disk. It waits for
+ *  requests, serves them one at a time in C-LOOK order, and
+ *  wakes each requester with its status. Every command to the
+ *  disk is issued here, under the disk mutex.
+ *
+ *  Parameters:
+ *         int devNo – disk device number, passed in a0
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void disk_dispatcher(int devNo){
+    disk_t *disk = &diskState[devNo];
     int disk_sem_idx = devSemIdx(DISKINT, devNo, FALSE);
-
     device_t *disk_dev_reg_addr = devAddrBase(DISKINT, devNo);
+    diskreq_t *req;
+    int disk_status;
 
-    int maxcyl = ((disk_dev_reg_addr->d_data1) >> 16) & 0xFFFF;
-    int maxhead = ((disk_dev_reg_addr->d_data1) >> 8) & 0xFF;
-    int maxsect = (disk_dev_reg_addr->d_data1) & 0xFF;
+    while (TRUE){
+        SYSCALL(PASSERN, &(disk->dk_pending), 0, 0);
+        SYSCALL(PASSERN, &(disk->dk_queueLock), 0, 0);
+            req = helper_clook_next(disk);
+        SYSCALL(VERHO, &(disk->dk_queueLock), 0, 0);
 
-    if ((saved_gen_exc_state->s_a1 < KUSEG) || (saved_gen_exc_state->s_a3 > (maxcyl*maxhead*maxsect))){         /*when setting up backing store as disk, depending on where on disk storing an image, it should be illegal to write there too*/
-        program_trap_handler(currentSupport, NULL);
+        SYSCALL(PASSERN, &(mutex[disk_sem_idx]), 0, 0);
+            disk_status = disk_seek(devNo, req->dr_cyl);
+            if (disk_status == READY){
+                disk_dev_reg_addr->d_data0 = req->dr_buf; /*carefull not to do anything with device between writing to data0 and command*/
+                setSTATUS(getSTATUS() & (~IECBITON));
+                    if (req->dr_write){
+                        disk_dev_reg_addr->d_command = (req->dr_head << HEADNUM_SHIFT) + (req->dr_sect << SECTNUM_SHIFT) + WRITEBLK_DSK;
+                    } else {
+                        disk_dev_reg_addr->d_command = (req->dr_head << HEADNUM_SHIFT) + (req->dr_sect << SECTNUM_SHIFT) + READBLK_DSK;
+                    }
+                    disk_status = SYSCALL(IOWAIT, DISKINT, devNo, 0);
+                setSTATUS(getSTATUS() | IECBITON);
+            }
+        SYSCALL(VERHO, &(mutex[disk_sem_idx]), 0, 0);
+
+        if (disk_status == READY){
+            req->dr_status = disk_status;
+        } else {
+            req->dr_status = 0 - disk_status;
+        }
+        SYSCALL(VERHO, &(req->dr_done), 0, 0);
     }
+}
 
-    SYSCALL(PASSERN, &(mutex[disk_sem_idx]), 0, 0);
-        int sectNo = saved_gen_exc_state->s_a3 % maxsect;
-        int headNo = ((int) (saved_gen_exc_state->s_a3 / (maxsect * maxcyl))) % maxhead;
-        int cylNo = ((int) (saved_gen_exc_state->s_a3 / maxsect)) % maxcyl;
-        setSTATUS(getSTATUS() & (~IECBITON));
-            disk_dev_reg_addr->d_command = (cylNo << CYLNUM_SHIFT) + SEEKCYL;
-            int disk_status = SYSCALL(IOWAIT, DISKINT, devNo, 0);
-        setSTATUS(getSTATUS() | IECBITON);
-        if (disk_status != READY){
-            saved_gen_exc_state->s_v0 = 0 - disk_status;
-            SYSCALL(VERHO, &(mutex[disk_sem_idx]), 0, 0);
-            return;
+/**********************************************************
+ *  disk_request
+ *
+ *  Queues a one block transfer on a disk and blocks until its
+ *  dispatcher has served it. The request lives on the stack
+ *  of the caller, which waits for it.
+ *
+ *  Parameters:
+ *         int devNo – disk device number
+ *         int cylNo, headNo, sectNo – position of the block
+ *         memaddr buf – RAM address of the block
+ *         int isWrite – TRUE to write the block, FALSE to read it
+ *
+ *  Returns:
+ *         int – READY, or the negated device status on error
+ **********************************************************/
+int disk_request(int devNo, int cylNo, int headNo, int sectNo, memaddr buf, int isWrite){
+    disk_t *disk = &diskState[devNo];
+    diskreq_t req;
+
+    req.dr_next = NULL;
+    req.dr_cyl = cylNo;
+    req.dr_head = headNo;
+    req.dr_sect = sectNo;
+    req.dr_buf = buf;
+    req.dr_write = isWrite;
+    req.dr_done = 0;
+
+    /* tail insertion keeps arrival order among requests of a cylinder */
+    SYSCALL(PASSERN, &(disk->dk_queueLock), 0, 0);
+        if (disk->dk_queue == NULL){
+            disk->dk_queue = &req;
+        } else {
+            diskreq_t *last = disk->dk_queue;
+            while (last->dr_next != NULL){
+                last = last->dr_next;
+            }
+            last->dr_next = &req;
         }
-        disk_dev_reg_addr->d_data0 = DISK_DMA_BUFFER_BASE_ADDR + (BLOCKSIZE*devNo);
-        setSTATUS(getSTATUS() & (~IECBITON));
-            disk_dev_reg_addr->d_command = (headNo << HEADNUM_SHIFT) + (sectNo << SECTNUM_SHIFT) + READBLK_DSK;
-            disk_status = SYSCALL(IOWAIT, DISKINT, devNo, 0);
-        setSTATUS(getSTATUS() | IECBITON);
-        helper_copy_block(DISK_DMA_BUFFER_BASE_ADDR + (BLOCKSIZE*devNo), saved_gen_exc_state->s_a1);
-    SYSCALL(VERHO, &(mutex[disk_sem_idx]), 0, 0);
+    SYSCALL(VERHO, &(disk->dk_queueLock), 0, 0);
+    SYSCALL(VERHO, &(disk->dk_pending), 0, 0);
 
-    if (disk_status == READY){
-        saved_gen_exc_state->s_v0 = disk_status;
-    } else{
-        saved_gen_exc_state->s_v0 = 0 - disk_status;
+    SYSCALL(PASSERN, &(req.dr_done), 0, 0);
+    return req.dr_status;
+}
+
+/**********************************************************
+ *  initDiskScheduler
+ *
+ *  Creates the dispatcher of every installed disk. Called by
+ *  test() once the backing store is set up, since from then on
+ *  only the dispatchers issue disk commands.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void initDiskScheduler(){
+    int devNo;
+    int installed = ((devregarea_t *)RAMBASEADDR)->inst_dev[0]; /* disks are the first device line */
+    state_t dispatcherState;
+
+    for (devNo = 0; devNo < DEVPERINT; devNo++){
+        if ((installed & (1 << devNo)) == 0){
+            continue;
+        }
+        dispatcherState.s_pc = (memaddr)disk_dispatcher;
+        dispatcherState.s_t9 = (memaddr)disk_dispatcher;
+        dispatcherState.s_a0 = devNo;
+        dispatcherState.s_sp = ((devregarea_t *)RAMBASEADDR)->rambase + ((devregarea_t *)RAMBASEADDR)->ramsize - ((DISK_STACK_FRAME + devNo) * PAGESIZE);
+        dispatcherState.s_status = (IEPBITON & KUPBITOFF) | IPBITS;
+        dispatcherState.s_entryHI = 0 << ASID_SHIFT;
+        SYSCALL(CREATETHREAD, &dispatcherState, NULL, 0);
     }
 }
 
-void READ_FROM_FLASH(support_t *currentSupport){
-    state_PTR saved_exception_state = &(currentSupport->sup_exceptState[GENERALEXCEPT]);
-    int devNo = saved_exception_state->s_a2;
-    int flash_sem_idx = devSemIdx(FLASHINT, devNo, FALSE);
+/**********************************************************
+ *  helper_dma_pin
+ *
+ *  Pins the pages of a user buffer for a device transfer and
+ *  gives the address for DATA0. A page aligned buffer is one
+ *  whole page: the device transfers straight to or from its
+ *  frame. A buffer crossing a page boundary goes through the
+ *  bounce buffer of the device; both its pages are pinned so
+ *  the copy made while holding the device mutex cannot fault.
+ *  Called before taking the device mutex, since a fault may
+ *  need the same device.
+ *
+ *  Parameters:
+ *         support_t *currentSupport – support struct of the U-proc
+ *         memaddr userBuf – virtual address of the buffer
+ *         memaddr bounce – bounce buffer of the device
+ *         int deviceWrites – TRUE if the device writes the buffer
+ *
+ *  Returns:
+ *         memaddr – address for DATA0
+ **********************************************************/
+HIDDEN memaddr helper_dma_pin(support_t *currentSupport, memaddr userBuf, memaddr bounce, int deviceWrites){
+    memaddr frameAddr = pin_user_page(currentSupport, userBuf, deviceWrites);
+    if ((userBuf % PAGESIZE) == 0){
+        return frameAddr;
+    }
+    pin_user_page(currentSupport, userBuf + BLOCKSIZE - WORDLEN, deviceWrites);
+    return bounce;
+}
 
-    device_t *flash_dev_reg_addr = devAddrBase(FLASHINT, devNo);
+/**********************************************************
+ *  helper_dma_unpin
+ *
+ *  Releases the pages pinned by helper_dma_pin once the
+ *  transfer is over.
+ *
+ *  Parameters:
+ *         support_t *currentSupport – support struct of the U-proc
+ *         memaddr userBuf – virtual address of the buffer
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_dma_unpin(support_t *currentSupport, memaddr userBuf){
+    unpin_user_page(currentSupport, userBuf);
+    if ((userBuf % PAGESIZE) != 0){
+        unpin_user_page(currentSupport, userBuf + BLOCKSIZE - WORDLEN);
+    }
+}
 
-    if ((saved_exception_state->s_a1 < KUSEG) || (saved_exception_state->s_a3 < 32) || (saved_exception_state->s_a3 >= flash_dev_reg_addr->d_data1)){ /* should it be illegal to read from backing store area in flash?*/
-        program_trap_handler(currentSupport, NULL);
+/**********************************************************
+ *  helper_device_block
+ *
+ *  Transfers one block between RAM and a disk or a flash.
+ *  A disk block is numbered as by DISK_GET/DISK_PUT and goes
+ *  through the queue of the disk; a flash block is transferred
+ *  under the mutex of the flash.
+ *
+ *  Parameters:
+ *         int devClass – DISKINT or FLASHINT
+ *         int devNo – device number
+ *         int block – block number on the device
+ *         memaddr buf – RAM address of the block
+ *         int isWrite – TRUE to write the block, FALSE to read it
+ *
+ *  Returns:
+ *         int – READY, or the negated device status on error
+ **********************************************************/
+HIDDEN int helper_device_block(int devClass, int devNo, int block, memaddr buf, int isWrite){
+    if (devClass == DISKINT){
+        int maxcyl = diskState[devNo].dk_maxcyl;
+        int maxhead = diskState[devNo].dk_maxhead;
+        int maxsect = diskState[devNo].dk_maxsect;
+        int sectNo = block % maxsect;
+        int headNo = ((int) (block / (maxsect * maxcyl))) % maxhead; /*divide and round down*/
+        int cylNo = ((int) (block / maxsect)) % maxcyl;
+        return disk_request(devNo, cylNo, headNo, sectNo, buf, isWrite);
     }
 
+    int flash_sem_idx = devSemIdx(FLASHINT, devNo, FALSE);
+    device_t *flash_dev_reg_addr = devAddrBase(FLASHINT, devNo);
     SYSCALL(PASSERN, &(mutex[flash_sem_idx]), 0, 0);
-        flash_dev_reg_addr->d_data0 = FLASK_DMA_BUFFER_BASE_ADDR + BLOCKSIZE*devNo;
+        flash_dev_reg_addr->d_data0 = buf;
         setSTATUS(getSTATUS() & (~IECBITON));
-            flash_dev_reg_addr->d_command = (saved_exception_state->s_a3 << BLOCKNUM_SHIFT) + READBLK_FLASH;
-            int flash_status = SYSCALL(IOWAIT,FLASHINT, devNo, 0);
+            if (isWrite){
+                flash_dev_reg_addr->d_command = (block << BLOCKNUM_SHIFT) + WRITEBLK_FLASH;
+            } else {
+                flash_dev_reg_addr->d_command = (block << BLOCKNUM_SHIFT) + READBLK_FLASH;
+            }
+            int flash_status = SYSCALL(IOWAIT, FLASHINT, devNo, 0);
         setSTATUS(getSTATUS() | IECBITON);
-        helper_copy_block(FLASK_DMA_BUFFER_BASE_ADDR + BLOCKSIZE*devNo, saved_exception_state->s_a1);
     SYSCALL(VERHO, &(mutex[flash_sem_idx]), 0, 0);
 
     if (flash_status == READY){
-        saved_exception_state->s_v0 = flash_status;
+        return flash_status;
     } else{
-        saved_exception_state->s_v0 = 0 - flash_status;
+        return 0 - flash_status;
     }
 }
 
-void WRITE_TO_FLASH(support_t *currentSupport){
-    state_PTR saved_exception_state = &(currentSupport->sup_exceptState[GENERALEXCEPT]);
-    int devNo = saved_exception_state->s_a2;
-    int flash_sem_idx = devSemIdx(FLASHINT, devNo, FALSE);
-    
+/**********************************************************
+ *  helper_device_blocks
+ *
+ *  Gives the number of blocks of a disk or a flash.
+ *
+ *  Parameters:
+ *         int devClass – DISKINT or FLASHINT
+ *         int devNo – device number
+ *
+ *  Returns:
+ *         int – blocks of the device
+ **********************************************************/
+HIDDEN int helper_device_blocks(int devClass, int devNo){
+    if (devClass == DISKINT){
+        return diskState[devNo].dk_maxcyl * diskState[devNo].dk_maxhead * diskState[devNo].dk_maxsect;
+    }
     device_t *flash_dev_reg_addr = devAddrBase(FLASHINT, devNo);
+    return flash_dev_reg_addr->d_data1;
+}
+
+/**********************************************************
+ *  helper_cache_find
+ *
+ *  Looks for the block cache entry of a block. Called with the
+ *  cache lock held.
+ *
+ *  Parameters:
+ *         int devClass – DISKINT or FLASHINT
+ *         int devNo – device number
+ *         int block – block number on the device
+ *
+ *  Returns:
+ *         blkbuf_t * – the entry, NULL if the block is not cached
+ **********************************************************/
+HIDDEN blkbuf_t *helper_cache_find(int devClass, int devNo, int block){
+    int i;
+    for (i = 0; i < blkCacheSize; i++){
+        if (blkCache[i].bb_state != BUF_EMPTY && blkCache[i].bb_class == devClass && blkCache[i].bb_devNo == devNo && blkCache[i].bb_block == block){
+            return &blkCache[i];
+        }
+    }
+    return NULL;
+}
+
+/**********************************************************
+ *  helper_cache_wait
+ *
+ *  Blocks until the transfer in flight on a cache entry ends.
+ *  Called and returns with the cache lock held; the entry may
+ *  hold another block on return.
+ *
+ *  Parameters:
+ *         blkbuf_t *buf – entry being filled or flushed
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_cache_wait(blkbuf_t *buf){
+    buf->bb_waiters++;
+    SYSCALL(VERHO, &blkCacheLock, 0, 0);
+    SYSCALL(PASSERN, &(buf->bb_waitSem), 0, 0);
+    SYSCALL(PASSERN, &blkCacheLock, 0, 0);
+}
+
+/**********************************************************
+ *  helper_cache_wake
+ *
+ *  Wakes everybody waiting for the transfer on a cache entry.
+ *  Called with the cache lock held.
+ *
+ *  Parameters:
+ *         blkbuf_t *buf – entry whose transfer ended
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_cache_wake(blkbuf_t *buf){
+    while (buf->bb_waiters > 0){
+        buf->bb_waiters--;
+        SYSCALL(VERHO, &(buf->bb_waitSem), 0, 0);
+    }
+}
+
+/**********************************************************
+ *  helper_cache_victim
+ *
+ *  Picks the least recently used entry with no transfer in
+ *  flight, among the clean ones (empty entries included) or
+ *  among the dirty ones. Called with the cache lock held.
+ *
+ *  Parameters:
+ *         int dirty – TRUE to look among the dirty entries
+ *
+ *  Returns:
+ *         blkbuf_t * – the entry, NULL if there is none
+ **********************************************************/
+HIDDEN blkbuf_t *helper_cache_victim(int dirty){
+    blkbuf_t *victim = NULL;
+    int i;
+    for (i = 0; i < blkCacheSize; i++){
+        int idle = (blkCache[i].bb_state == BUF_EMPTY || blkCache[i].bb_state == BUF_VALID);
+        if (idle && blkCache[i].bb_dirty == dirty && (victim == NULL || blkCache[i].bb_lastUse < victim->bb_lastUse)){
+            victim = &blkCache[i];
+        }
+    }
+    return victim;
+}
+
+/**********************************************************
+ *  helper_cache_write_back
+ *
+ *  Writes a dirty entry to its device. The entry stays
+ *  readable while FLUSHING, PUTs to it wait. The PUT already
+ *  returned READY, so a write that fails empties the entry
+ *  and leaves its status in blkDevError, returned by the next
+ *  PUT or GET to the device.
+ *  Called and returns with the cache lock held.
+ *
+ *  Parameters:
+ *         blkbuf_t *buf – dirty entry
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_cache_write_back(blkbuf_t *buf){
+    int status;
+
+    buf->bb_state = BUF_FLUSHING;
+    SYSCALL(VERHO, &blkCacheLock, 0, 0);
+    status = helper_device_block(buf->bb_class, buf->bb_devNo, buf->bb_block, buf->bb_data, TRUE);
+    SYSCALL(PASSERN, &blkCacheLock, 0, 0);
+    buf->bb_dirty = FALSE;
+    if (status == READY){
+        buf->bb_state = BUF_VALID;
+        cacheWriteBacks++;
+    } else {
+        /* the device does not hold the block: a later GET must not find it cached */
+        buf->bb_state = BUF_EMPTY;
+        buf->bb_lastUse = 0;
+        if (blkDevError[buf->bb_class - DISKINT][buf->bb_devNo] == 0){
+            blkDevError[buf->bb_class - DISKINT][buf->bb_devNo] = status;
+        }
+        cacheWriteErrors++;
+    }
+    helper_cache_wake(buf);
+}
+
+/**********************************************************
+ *  helper_cache_claim
+ *
+ *  Gets an entry for a block not cached: the least recently
+ *  used clean one, else the least recently used dirty one once
+ *  written back. When every entry has a transfer in flight,
+ *  waits for one of them. Called with the cache lock held,
+ *  which is released meanwhile, so the caller looks the block
+ *  up again when NULL is returned.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *         blkbuf_t * – a clean idle entry, NULL to look again
+ **********************************************************/
+HIDDEN blkbuf_t *helper_cache_claim(){
+    blkbuf_t *buf = helper_cache_victim(FALSE);
+    if (buf != NULL){
+        return buf;
+    }
+    buf = helper_cache_victim(TRUE);
+    if (buf != NULL){
+        helper_cache_write_back(buf);
+    } else {
+        helper_cache_wait(&blkCache[0]);
+    }
+    return NULL;
+}
+
+/**********************************************************
+ *  helper_cache_get
+ *
+ *  Serves a GET through the block cache. A hit is copied out
+ *  of its entry, waiting first for a prefetch in flight; a
+ *  miss is read into a claimed entry, then copied. The
+ *  buffer is the bounce buffer of the device, so the copies
+ *  holding the cache lock cannot fault.
+ *
+ *  Parameters:
+ *         int devClass – DISKINT or FLASHINT
+ *         int devNo – device number
+ *         int block – block number on the device
+ *         memaddr dst – kernel buffer receiving the block
+ *
+ *  Returns:
+ *         int – READY, or the negated device status on error
+ **********************************************************/
+HIDDEN int helper_cache_get(int devClass, int devNo, int block, memaddr dst){
+    blkbuf_t *buf = NULL;
+    int status;
+
+    SYSCALL(PASSERN, &blkCacheLock, 0, 0);
+    while (buf == NULL){
+        buf = helper_cache_find(devClass, devNo, block);
+        if (buf != NULL && buf->bb_state == BUF_FILLING){
+            helper_cache_wait(buf);
+            buf = NULL;
+        } else if (buf != NULL){
+            helper_copy_block(buf->bb_data, dst);
+            buf->bb_lastUse = ++blkCacheClock;
+            cacheHits++;
+            SYSCALL(VERHO, &blkCacheLock, 0, 0);
+            return READY;
+        } else {
+            buf = helper_cache_claim();
+        }
+    }
+    cacheMisses++;
+    buf->bb_class = devClass;
+    buf->bb_devNo = devNo;
+    buf->bb_block = block;
+    buf->bb_state = BUF_FILLING;
+    buf->bb_lastUse = ++blkCacheClock;
+    SYSCALL(VERHO, &blkCacheLock, 0, 0);
+
+    status = helper_device_block(devClass, devNo, block, buf->bb_data, FALSE);
+
+    SYSCALL(PASSERN, &blkCacheLock, 0, 0);
+    if (status == READY){
+        buf->bb_state = BUF_VALID;
+        helper_copy_block(buf->bb_data, dst);
+    } else {
+        buf->bb_state = BUF_EMPTY;
+        buf->bb_lastUse = 0;
+    }
+    helper_cache_wake(buf);
+    SYSCALL(VERHO, &blkCacheLock, 0, 0);
+    return status;
+}
+
+/**********************************************************
+ *  helper_cache_put
+ *
+ *  Serves a PUT by copying the user buffer into the entry of
+ *  the block, claimed if the block is not cached, and marking
+ *  it dirty: the device is written later by the flush daemon
+ *  or when the entry is evicted. A transfer in flight on the
+ *  entry is waited for first. The buffer is the bounce buffer
+ *  of the device, so the copy holding the cache lock cannot
+ *  fault.
+ *
+ *  Parameters:
+ *         int devClass – DISKINT or FLASHINT
+ *         int devNo – device number
+ *         int block – block number on the device
+ *         memaddr src – kernel buffer holding the block
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_cache_put(int devClass, int devNo, int block, memaddr src){
+    blkbuf_t *buf = NULL;
+
+    SYSCALL(PASSERN, &blkCacheLock, 0, 0);
+    while (buf == NULL){
+        buf = helper_cache_find(devClass, devNo, block);
+        if (buf != NULL && buf->bb_state != BUF_VALID){
+            helper_cache_wait(buf);
+            buf = NULL;
+        } else if (buf == NULL){
+            buf = helper_cache_claim();
+            if (buf != NULL){
+                buf->bb_class = devClass;
+                buf->bb_devNo = devNo;
+                buf->bb_block = block;
+            }
+        }
+    }
+    helper_copy_block(src, buf->bb_data);
+    buf->bb_state = BUF_VALID;
+    buf->bb_dirty = TRUE;
+    buf->bb_lastUse = ++blkCacheClock;
+    cacheWritesCached++;
+    if (flushAsleep){
+        flushAsleep = FALSE;
+        SYSCALL(VERHO, &flushWork, 0, 0);
+    }
+    SYSCALL(VERHO, &blkCacheLock, 0, 0);
+}
+
+/**********************************************************
+ *  helper_cache_error
+ *
+ *  Takes the status of a write-back to a device that failed
+ *  since the last PUT or GET to it, like the pending error of
+ *  a terminal or a printer.
+ *
+ *  Parameters:
+ *         int devClass – DISKINT or FLASHINT
+ *         int devNo – device number
+ *
+ *  Returns:
+ *         int – 0, or the negated device status of the failure
+ **********************************************************/
+HIDDEN int helper_cache_error(int devClass, int devNo){
+    int status;
+
+    SYSCALL(PASSERN, &blkCacheLock, 0, 0);
+    status = blkDevError[devClass - DISKINT][devNo];
+    blkDevError[devClass - DISKINT][devNo] = 0;
+    SYSCALL(VERHO, &blkCacheLock, 0, 0);
+    if (status == 0){
+        return 0;
+    }
+    return 0 - status;
+}
+
+/**********************************************************
+ *  helper_read_ahead
+ *
+ *  Tracks the last block each U-proc read from each device.
+ *  When a GET follows the previous one of the U-proc on the
+ *  device, the next READAHEAD_BLOCKS blocks not cached yet are
+ *  queued for the prefetch daemon, each into the least
+ *  recently used clean entry: a prefetch never waits for a
+ *  write-back.
+ *
+ *  Parameters:
+ *         int asid – U-proc issuing the GET
+ *         int devClass – DISKINT or FLASHINT
+ *         int devNo – device number
+ *         int block – block just read
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_read_ahead(int asid, int devClass, int devNo, int block){
+    int *last = &(seqLast[devClass - DISKINT][devNo][asid]);
+    int sequential = (block == *last + 1);
+    int deviceBlocks = helper_device_blocks(devClass, devNo);
+    int k;
+
+    *last = block;
+    if (!sequential){
+        return;
+    }
+
+    SYSCALL(PASSERN, &blkCacheLock, 0, 0);
+    for (k = 1; k <= READAHEAD_BLOCKS && block + k < deviceBlocks; k++){
+        if (helper_cache_find(devClass, devNo, block + k) != NULL){
+            continue;
+        }
+        blkbuf_t *victim = helper_cache_victim(FALSE);
+        if (victim == NULL){
+            break;
+        }
+        victim->bb_class = devClass;
+        victim->bb_devNo = devNo;
+        victim->bb_block = block + k;
+        victim->bb_state = BUF_FILLING;
+        victim->bb_lastUse = ++blkCacheClock;
+        prefetchRing[prefetchTail] = victim;
+        prefetchTail = (prefetchTail + 1) % BLKCACHE_SIZE;
+        cachePrefetches++;
+        SYSCALL(VERHO, &prefetchPending, 0, 0);
+    }
+    SYSCALL(VERHO, &blkCacheLock, 0, 0);
+}
+
+/**********************************************************
+ *  prefetch_daemon
+ *
+ *  Body of the kernel-mode process filling the block cache
+ *  entries queued by helper_read_ahead, one at a time, and
+ *  waking the GETs and PUTs waiting for them.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void prefetch_daemon(){
+    blkbuf_t *buf;
+    int status;
+
+    while (TRUE){
+        SYSCALL(PASSERN, &prefetchPending, 0, 0);
+        SYSCALL(PASSERN, &blkCacheLock, 0, 0);
+            buf = prefetchRing[prefetchHead];
+            prefetchHead = (prefetchHead + 1) % BLKCACHE_SIZE;
+        SYSCALL(VERHO, &blkCacheLock, 0, 0);
+
+        status = helper_device_block(buf->bb_class, buf->bb_devNo, buf->bb_block, buf->bb_data, FALSE);
+
+        SYSCALL(PASSERN, &blkCacheLock, 0, 0);
+            if (status == READY){
+                buf->bb_state = BUF_VALID;
+            } else {
+                buf->bb_state = BUF_EMPTY;
+                buf->bb_lastUse = 0;
+            }
+            helper_cache_wake(buf);
+        SYSCALL(VERHO, &blkCacheLock, 0, 0);
+    }
+}
+
+/**********************************************************
+ *  flushBlockCache
+ *
+ *  Writes every dirty block cache entry back to its device.
+ *  Run periodically by the flush daemon and by test() before
+ *  the report, so every PUT reaches its device.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void flushBlockCache(){
+    int i;
+
+    SYSCALL(PASSERN, &blkCacheLock, 0, 0);
+    for (i = 0; i < blkCacheSize; i++){
+        if (blkCache[i].bb_state == BUF_VALID && blkCache[i].bb_dirty){
+            helper_cache_write_back(&blkCache[i]);
+        }
+    }
+    SYSCALL(VERHO, &blkCacheLock, 0, 0);
+}
+
+/**********************************************************
+ *  flush_daemon
+ *
+ *  Body of the kernel-mode process flushing the block cache
+ *  FLUSH_DELAY microseconds after a block is dirtied, bounding
+ *  how long a PUT stays in RAM only. With no dirty block it
+ *  sleeps until the next PUT, so it does not keep the
+ *  pseudo-clock ticking while the machine idles.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void flush_daemon(){
+    int i;
+    int dirty;
+    cpu_t now;
+
+    while (TRUE){
+        SYSCALL(PASSERN, &blkCacheLock, 0, 0);
+        dirty = FALSE;
+        for (i = 0; i < blkCacheSize; i++){
+            if (blkCache[i].bb_dirty){
+                dirty = TRUE;
+            }
+        }
+        if (!dirty){
+            flushAsleep = TRUE;
+            SYSCALL(VERHO, &blkCacheLock, 0, 0);
+            SYSCALL(PASSERN, &flushWork, 0, 0);
+        } else {
+            SYSCALL(VERHO, &blkCacheLock, 0, 0);
+        }
+
+        STCK(now);
+        SYSCALL(TODWAIT, now + FLUSH_DELAY, 0, 0);
+        flushBlockCache();
+    }
+}
+
+/**********************************************************
+ *  initBlockCache
+ *
+ *  Gives every block cache entry a frame of kernel RAM and
+ *  creates the prefetch and the flush daemons. Called by test()
+ *  once the disk dispatchers exist.
+ *
+ *  Parameters:
+ *
+ *
+ *  Returns:
+ *
+ **********************************************************/
+void initBlockCache(){
+    int i;
+    int j;
+    int k;
+    state_t daemonState;
 
-    if ((saved_exception_state->s_a1 < KUSEG) || (saved_exception_state->s_a3 < 32) || (saved_exception_state->s_a3 >= flash_dev_reg_addr->d_data1)){
+    blkCacheLock = 1;
+    blkCacheClock = 0;
+    prefetchPending = 0;
+    prefetchHead = 0;
+    prefetchTail = 0;
+    flushAsleep = FALSE;
+    flushWork = 0;
+    cacheHits = 0;
+    cacheMisses = 0;
+    cachePrefetches = 0;
+    cacheWritesCached = 0;
+    cacheWriteBacks = 0;
+    cacheWriteErrors = 0;
+    for (i = 0; i < 2; i++){
+        for (j = 0; j < DEVPERINT; j++){
+            blkDevError[i][j] = 0;
+            for (k = 0; k <= UPROC_NUM; k++){
+                seqLast[i][j][k] = NOBLOCK;
+            }
+        }
+    }
+
+    /* the free RAM is shared with the nucleus */
+    setSTATUS(getSTATUS() & (~IECBITON));
+    for (blkCacheSize = 0; blkCacheSize < BLKCACHE_SIZE; blkCacheSize++){
+        memaddr frame = allocKernelFrame();
+        if (frame == (memaddr)NULL){
+            break;
+        }
+        blkCache[blkCacheSize].bb_data = frame;
+        blkCache[blkCacheSize].bb_state = BUF_EMPTY;
+        blkCache[blkCacheSize].bb_dirty = FALSE;
+        blkCache[blkCacheSize].bb_lastUse = 0;
+        blkCache[blkCacheSize].bb_waiters = 0;
+        blkCache[blkCacheSize].bb_waitSem = 0;
+    }
+    setSTATUS(getSTATUS() | IECBITON);
+
+    daemonState.s_pc = (memaddr)prefetch_daemon;
+    daemonState.s_t9 = (memaddr)prefetch_daemon;
+    daemonState.s_sp = ((devregarea_t *)RAMBASEADDR)->rambase + ((devregarea_t *)RAMBASEADDR)->ramsize - (PREFETCH_STACK_FRAME * PAGESIZE);
+    daemonState.s_status = (IEPBITON & KUPBITOFF) | IPBITS;
+    daemonState.s_entryHI = 0 << ASID_SHIFT;
+    SYSCALL(CREATETHREAD, &daemonState, NULL, 0);
+
+    daemonState.s_pc = (memaddr)flush_daemon;
+    daemonState.s_t9 = (memaddr)flush_daemon;
+    daemonState.s_sp = ((devregarea_t *)RAMBASEADDR)->rambase + ((devregarea_t *)RAMBASEADDR)->ramsize - (FLUSH_STACK_FRAME * PAGESIZE);
+    SYSCALL(CREATETHREAD, &daemonState, NULL, 0);
+}
+
+/**********************************************************
+ *  helper_user_block
+ *
+ *  Serves DISK_PUT (SYS14), DISK_GET (SYS15), FLASH_PUT (SYS16)
+ *  and FLASH_GET (SYS17) through the write-back block cache: a
+ *  PUT returns once the block is cached. The user buffer is
+ *  copied through the bounce buffer of the device, under its
+ *  bounce lock, outside the cache lock: a page fault on it
+ *  only holds up that device. A write-back to the device that
+ *  failed since the last call is returned instead of serving
+ *  the request. Only when the cache got no frame does the
+ *  device transfer straight to or from the pinned user buffer
+ *  or, when it crosses a page boundary, through the bounce
+ *  buffer.
+ *
+ *  Parameters:
+ *         support_t *currentSupport – support struct of the U-proc
+ *         int devClass – DISKINT or FLASHINT
+ *         int isWrite – TRUE for a PUT, FALSE for a GET
+ *
+ *  Returns:
+ *
+ **********************************************************/
+HIDDEN void helper_user_block(support_t *currentSupport, int devClass, int isWrite){
+    state_PTR saved_gen_exc_state = &(currentSupport->sup_exceptState[GENERALEXCEPT]);
+
+    memaddr userBuf = saved_gen_exc_state->s_a1;
+    int devNo = saved_gen_exc_state->s_a2;
+    int block = saved_gen_exc_state->s_a3;
+    memaddr bounce;
+    int *bounceSem;
+    int status;
+
+    /* devNo indexes the device tables below: it must name an installed device */
+    if ((devNo < 0) || (devNo >= DEVPERINT) || ((((devregarea_t *)RAMBASEADDR)->inst_dev[devClass - DISKINT] & (1 << devNo)) == 0)){
         program_trap_handler(currentSupport, NULL);
     }
-    
-    SYSCALL(PASSERN, &(mutex[flash_sem_idx]), 0, 0);
-        helper_copy_block(saved_exception_state->s_a1, FLASK_DMA_BUFFER_BASE_ADDR + BLOCKSIZE*devNo);
-        flash_dev_reg_addr->d_data0 = FLASK_DMA_BUFFER_BASE_ADDR + BLOCKSIZE*devNo;
-        setSTATUS(getSTATUS() & (~IECBITON));
-            flash_dev_reg_addr->d_command = (saved_exception_state->s_a3 << BLOCKNUM_SHIFT) + WRITEBLK_FLASH;
-            int flash_status = SYSCALL(IOWAIT, FLASHINT, devNo, 0);
-        setSTATUS(getSTATUS() | IECBITON);
-    SYSCALL(VERHO, &(mutex[flash_sem_idx]), 0, 0);
 
-    if (flash_status == READY){
-        saved_exception_state->s_v0 = flash_status;
-    } else{
-        saved_exception_state->s_v0 = 0 - flash_status;
+    if (devClass == DISKINT){
+        if ((userBuf < KUSEG) || (block < 0) || (block >= helper_device_blocks(DISKINT, devNo))){         /*when setting up backing store as disk, depending on where on disk storing an image, it should be illegal to write there too*/
+            program_trap_handler(currentSupport, NULL);
+        }
+        bounce = DISK_DMA_BUFFER_BASE_ADDR + (BLOCKSIZE*devNo);
+        bounceSem = &(diskState[devNo].dk_bounceSem);
+    } else {
+        if ((userBuf < KUSEG) || (block < 32) || (block >= helper_device_blocks(FLASHINT, devNo))){ /* should it be illegal to read from backing store area in flash?*/
+            program_trap_handler(currentSupport, NULL);
+        }
+        bounce = FLASK_DMA_BUFFER_BASE_ADDR + BLOCKSIZE*devNo;
+        bounceSem = &(flashBounceSem[devNo]);
     }
-}
\ No newline at end of file
+
+    if (blkCacheSize > 0){
+        status = helper_cache_error(devClass, devNo);
+        if (status != 0){
+            saved_gen_exc_state->s_v0 = status;
+            return;
+        }
+        /* the first and last words are touched before any lock, a bad buffer kills the U-proc holding none */
+        *((volatile int *)userBuf);
+        *((volatile int *)(userBuf + BLOCKSIZE - WORDLEN));
+        SYSCALL(PASSERN, bounceSem, 0, 0);
+        if (isWrite){
+            helper_copy_block(userBuf, bounce);
+            helper_cache_put(devClass, devNo, block, bounce);
+            status = READY;
+        } else {
+            status = helper_cache_get(devClass, devNo, block, bounce);
+            if (status == READY){
+                helper_copy_block(bounce, userBuf);
+            }
+        }
+        SYSCALL(VERHO, bounceSem, 0, 0);
+    } else {
+        memaddr dma_addr = helper_dma_pin(currentSupport, userBuf, bounce, !isWrite);
+        if (dma_addr == bounce){
+            /* the buffer crosses a page boundary, the device reads or writes the bounce buffer */
+            SYSCALL(PASSERN, bounceSem, 0, 0);
+            if (isWrite){
+                helper_copy_block(userBuf, bounce);
+            }
+        }
+        status = helper_device_block(devClass, devNo, block, dma_addr, isWrite);
+        if (dma_addr == bounce){
+            if (!isWrite){
+                helper_copy_block(bounce, userBuf);
+            }
+            SYSCALL(VERHO, bounceSem, 0, 0);
+        }
+        helper_dma_unpin(currentSupport, userBuf);
+    }
+
+    if (!isWrite && status == READY){
+        helper_read_ahead(currentSupport->sup_asid, devClass, devNo, block);
+    }
+    saved_gen_exc_state->s_v0 = status;
+}
+
+void WRITE_TO_DISK(support_t *currentSupport){
+    helper_user_block(currentSupport, DISKINT, TRUE);
+}
+
+void READ_FROM_DISK(support_t *currentSupport){
+    helper_user_block(currentSupport, DISKINT, FALSE);
+}
+
+void READ_FROM_FLASH(support_t *currentSupport){
+    helper_user_block(currentSupport, FLASHINT, FALSE);
+}
+
+void WRITE_TO_FLASH(support_t *currentSupport){
+    helper_user_block(currentSupport, FLASHINT, TRUE);
+}
@@ -10,7 +10,20 @@
 
 extern int masterSemaphore;
 extern int mutex[DEVINTNUM * DEVPERINT + DEVPERINT];
+extern disk_t diskState[DEVPERINT];
+extern int cacheHits;
+extern int cacheMisses;
+extern int cachePrefetches;
+extern int cacheWritesCached;
+extern int cacheWriteBacks;
+extern int cacheWriteErrors;
 
+void initDiskState();
+int disk_seek(int devNo, int cylNo);
+int disk_request(int devNo, int cylNo, int headNo, int sectNo, memaddr buf, int isWrite);
+void initDiskScheduler();
+void initBlockCache();
+void flushBlockCache();
 void WRITE_TO_DISK(support_t *currentSupport);
 void READ_FROM_DISK(support_t *currentSupport);
 void READ_FROM_FLASH(support_t *currentSupport);
@@ -1,6 +1,6 @@
-/************************** SYSSUPPORT.H ******************************
+/************************* DELAYDAEMON.H *****************************
  *
- *  The externals declaration file for SYSSUPPORT Module
+ *  The externals declaration file for DELAYDAEMON Module
  *
  */
 
@@ -14,7 +14,12 @@
 #include "../h/types.h"
 #include "../h/const.h"
 
-void initADL();
+extern int delayWakeups[NCPU];
+extern int delayLatenessTotal[NCPU];
+extern int delayLatenessMax[NCPU];
+
+void initDelay();
 void DELAY(support_t *currentSupport);
+void DELAY_US(support_t *currentSupport);
 
 #endif
\ No newline at end of file